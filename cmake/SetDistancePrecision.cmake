@@ -0,0 +1,31 @@
+# This module provides a CMake configuration variable to choose the
+# element type of the distance matrix. Possible values are:
+# * DOUBLE: full precision, the default.
+# * FLOAT: single precision. The matrix takes half as much memory,
+#   so a much larger part of it stays in cache on 1000+ customer
+#   instances. Time-window arithmetic is still done in double and
+#   every new incumbent is re-checked against full-precision
+#   distances before it is accepted.
+
+set(DISTANCE_PRECISION "DOUBLE" CACHE STRING
+    "Distance matrix element type: DOUBLE, FLOAT")
+set_property(CACHE DISTANCE_PRECISION PROPERTY STRINGS DOUBLE FLOAT)
+
+string(TOUPPER "${DISTANCE_PRECISION}" DISTANCE_PRECISION_UPPER)
+if(DISTANCE_PRECISION_UPPER STREQUAL "DOUBLE")
+    set(DISTANCE_MATRIX_FLOAT 0)
+elseif(DISTANCE_PRECISION_UPPER STREQUAL "FLOAT")
+    set(DISTANCE_MATRIX_FLOAT 1)
+else()
+    message(FATAL_ERROR "[SetDistancePrecision] Unsupported "
+        "DISTANCE_PRECISION='${DISTANCE_PRECISION}'. Expected DOUBLE or FLOAT.")
+endif()
+message(STATUS "[SetDistancePrecision] Distance matrix precision: "
+    "${DISTANCE_PRECISION_UPPER}")
+
+# Propagate the value to the sources.
+add_definitions(-DDISTANCE_MATRIX_FLOAT=${DISTANCE_MATRIX_FLOAT})
+
+# XXX: Unset variables to avoid spoiliing CMake environment.
+unset(DISTANCE_PRECISION_UPPER)
+unset(DISTANCE_MATRIX_FLOAT)
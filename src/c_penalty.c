@@ -10,25 +10,33 @@
 #include "utils.h"
 #include "penalty_inline.h"
 
-void
-c_penalty_init(struct route *r)
+static ALWAYS_INLINE void
+c_penalty_update_forward_from(struct route *r, int start_idx)
 {
-	struct customer *prev = depot_head(r);
-	prev->demand_pf = prev->demand;
-	for (int i = 1; i < r->size; i++) {
-		struct customer *next = r->customers[i];
-		next->demand_pf =
-			prev->demand_pf + next->demand;
-		prev = next;
+	if (start_idx == 0) {
+		r->demand_pf[0] = r->demand[0];
+		start_idx = 1;
 	}
-	struct customer *next = depot_tail(r);
-	next->demand_sf = next->demand;
-	for (int i = r->size - 2; i >= 0; i--) {
-		prev = r->customers[i];
-		prev->demand_sf =
-			next->demand_sf + prev->demand;
-		next = prev;
+	for (int i = start_idx; i < r->size; i++)
+		r->demand_pf[i] = r->demand_pf[i - 1] + r->demand[i];
+}
+
+static ALWAYS_INLINE void
+c_penalty_update_backward_from(struct route *r, int start_idx)
+{
+	if (start_idx == r->size - 1) {
+		r->demand_sf[start_idx] = r->demand[start_idx];
+		start_idx--;
 	}
+	for (int i = start_idx; i >= 0; i--)
+		r->demand_sf[i] = r->demand_sf[i + 1] + r->demand[i];
+}
+
+void
+c_penalty_init(struct route *r)
+{
+	c_penalty_update_forward_from(r, 0);
+	c_penalty_update_backward_from(r, r->size - 1);
 }
 
 void
@@ -38,20 +46,7 @@ c_penalty_update_forward(struct customer *start)
 		return;
 	struct route *r = start->route;
 	assert(r != NULL);
-
-	if (start == depot_head(r)) {
-		start->demand_pf = start->demand;
-		start = route_next(start);
-		if (start->idx >= r->size)
-			return;
-	}
-
-	struct customer *prev = route_prev(start);
-	for (int i = start->idx; i < r->size; i++) {
-		struct customer *cur = r->customers[i];
-		cur->demand_pf = prev->demand_pf + cur->demand;
-		prev = cur;
-	}
+	c_penalty_update_forward_from(r, start->idx);
 }
 
 void
@@ -61,20 +56,7 @@ c_penalty_update_backward(struct customer *start)
 		return;
 	struct route *r = start->route;
 	assert(r != NULL);
-
-	if (start == depot_tail(r)) {
-		start->demand_sf = start->demand;
-		start = route_prev(start);
-		if (start->idx < 0)
-			return;
-	}
-
-	struct customer *next = route_next(start);
-	for (int i = start->idx; i >= 0; i--) {
-		struct customer *cur = r->customers[i];
-		cur->demand_sf = next->demand_sf + cur->demand;
-		next = cur;
-	}
+	c_penalty_update_backward_from(r, start->idx);
 }
 
 double
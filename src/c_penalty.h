@@ -1,10 +1,6 @@
 #ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_C_PENALTY_H
 #define EAMA_ROUTES_MINIMIZATION_HEURISTIC_C_PENALTY_H
 
-#define c_penalty_attr 	\
-    double demand_pf;	\
-    double demand_sf
-
 #include "problem.h"
 
 struct customer;
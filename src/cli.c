@@ -22,6 +22,16 @@ static const char *log_levels[3] = {
 	[LOGLEVEL_VERBOSE] = "verbose",
 };
 
+static const char *neighbourhood_modes[2] = {
+	[NEIGHBOURHOOD_CALLBACK] = "callback",
+	[NEIGHBOURHOOD_FIBER] = "fiber",
+};
+
+static const char *neighbours_rankings[2] = {
+	[NEIGHBOURS_DISTANCE] = "distance",
+	[NEIGHBOURS_TIME_WINDOWS] = "time_windows",
+};
+
 static void
 usage(void)
 {
@@ -31,14 +41,19 @@ usage(void)
 	printf("  --beta_correction       - Enables beta-correction mechanism.\n");
 	printf("  --log_level <option>    - Log level: none, normal, verbose.\n");
 	printf("  --n_near <value>        - Sets the preferred n_near.\n");
+	printf("  --threads <value>       - Threads of the preprocessing and insert-eject.\n");
+	printf("  --neighbourhood <option> - Neighbourhood enumeration: callback, fiber.\n");
+	printf("  --neighbours <option>   - Neighbour lists ranking: distance, time_windows.\n");
 	printf("  --k_max <value>         - Sets the preferred k_max.\n");
-	printf("  --t_max <value>         - Sets the preferred t_max (in secs).\n");
+	printf("  --t_max <value>         - Sets the preferred t_max (in wall-clock secs).\n");
 	printf("  --t_max_ms <value>      - Sets the budget in milliseconds (overrides --t_max).\n");
 	printf("  --i_rand <value>        - Sets the preferred i_rand.\n");
 	printf("  --lower_bound <value>   - Sets the preferred lower_bound.\n");
 	printf("  --seed <value>          - Sets the pseudo-random seed.\n");
 	printf("  --initial_solution <f>  - Import initial solution from file.\n");
+	printf("  --cache_dir <dir>       - Directory of the preprocessed instance cache.\n");
 	printf("  --log_incumbent_solutions - Emit full incumbent routes as JSON lines.\n");
+	printf("  --binary_solution       - Write the solution in the binary route format.\n");
 }
 
 bool
@@ -141,6 +156,26 @@ parse_option(void)
 				options.n_near = parse_next_int_value("n_near");
 				return;
 			}
+			if (match_longopt("threads")) {
+				options.n_threads = parse_next_int_value("threads");
+				return;
+			}
+			if (match_longopt("neighbourhood")) {
+				if (at_end())
+					panic("error: --neighbourhood needs a valid option.");
+				options.neighbourhood = (neighbourhood_mode)
+					parse_multi_option(next_arg(), 2,
+							   neighbourhood_modes);
+				return;
+			}
+			if (match_longopt("neighbours")) {
+				if (at_end())
+					panic("error: --neighbours needs a valid option.");
+				options.neighbours = (neighbours_ranking)
+					parse_multi_option(next_arg(), 2,
+							   neighbours_rankings);
+				return;
+			}
 			if (match_longopt("k_max")) {
 				options.k_max = parse_next_int_value("k_max");
 				return;
@@ -160,10 +195,20 @@ parse_option(void)
 				options.initial_solution_file = next_arg();
 				return;
 			}
+			if (match_longopt("cache_dir")) {
+				if (at_end())
+					panic("error: --cache_dir needs a directory path.");
+				options.cache_dir = next_arg();
+				return;
+			}
 			if (match_longopt("log_incumbent_solutions")) {
 				options.log_incumbent_solutions = true;
 				return;
 			}
+			if (match_longopt("binary_solution")) {
+				options.binary_solution = true;
+				return;
+			}
 			if (match_longopt("i_rand")) {
 				options.i_rand = parse_next_int_value("i_rand");
 				return;
@@ -198,10 +243,15 @@ parse_arguments(int argc, const char *argv[])
 	options.problem_file = args[1];
 	options.solution_file = args[2];
 	options.initial_solution_file = NULL;
+	options.cache_dir = NULL;
 	options.log_incumbent_solutions = false;
+	options.binary_solution = false;
 	options.beta_correction = false;
 	options.log_level = LOGLEVEL_VERBOSE;
 	options.n_near = 100;
+	options.n_threads = 1;
+	options.neighbourhood = NEIGHBOURHOOD_CALLBACK;
+	options.neighbours = NEIGHBOURS_DISTANCE;
 	options.k_max = 5;
 	options.t_max = (clock_t)365 * 86400 * 100;
 	options.t_max_ms = -1;
@@ -13,14 +13,33 @@ typedef enum
     LOGLEVEL_VERBOSE,
 } log_level;
 
+/** How squeeze enumerates the neighbourhood of a route */
+typedef enum
+{
+    NEIGHBOURHOOD_CALLBACK,
+    NEIGHBOURHOOD_FIBER,
+} neighbourhood_mode;
+
+/** How the neighbour lists of the customers are ranked */
+typedef enum
+{
+    NEIGHBOURS_DISTANCE,
+    NEIGHBOURS_TIME_WINDOWS,
+} neighbours_ranking;
+
 struct cli_options {
     const char *problem_file;
     const char *solution_file;
     const char *initial_solution_file; /* NULL when not provided */
+    const char *cache_dir; /* NULL when not provided */
     bool log_incumbent_solutions;
+    bool binary_solution;
 	bool beta_correction;
     log_level log_level;
     int n_near;
+    int n_threads;
+    neighbourhood_mode neighbourhood;
+    neighbours_ranking neighbours;
     int k_max;
     clock_t t_max;
     int64_t t_max_ms;   /* millisecond budget; -1 when not provided */
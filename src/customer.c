@@ -1,10 +1,11 @@
 #include "customer.h"
 
+#include "pools.h"
+
 struct customer *
 customer_dup(struct customer *c)
 {
-	/* TODO: use mempool to allocate customers */
-	struct customer *dup = xmalloc(sizeof(*c));
+	struct customer *dup = xmempool_alloc(&pools.customer);
 	*dup = *c;
 	dup->route = NULL;
 	dup->idx = -1;
@@ -18,6 +19,5 @@ customer_dup(struct customer *c)
 void
 customer_delete(struct customer *c)
 {
-	/* TODO: return back to mempool */
-	free(c);
+	mempool_free(&pools.customer, c);
 }
@@ -20,10 +20,10 @@ struct customer {
 	double l;
 	double s;
 	feasible_ejections_attr;
-	tw_penalty_attr;
-	c_penalty_attr;
 	distance_attr;
 	struct route *route;
+	/** Position in the route, see struct route for the penalty data */
+	int idx;
 	struct rlist in_route;
 	struct rlist in_eject;
 	struct rlist in_eject_temp;
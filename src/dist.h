@@ -3,10 +3,37 @@
 
 #include "problem.h"
 
+double ALWAYS_INLINE
+dist_id(int lhs, int rhs)
+{
+	return p.distance_matrix[lhs * p.distance_matrix_stride + rhs];
+}
+
 double ALWAYS_INLINE
 dist(struct customer *lhs, struct customer *rhs)
 {
-	return p.distance_matrix[lhs->id][rhs->id];
+	return dist_id(lhs->id, rhs->id);
+}
+
+/** See problem::infeasible_arcs */
+bool ALWAYS_INLINE
+arc_infeasible_id(int lhs, int rhs)
+{
+	uint64_t word = p.infeasible_arcs[lhs * p.infeasible_arcs_stride +
+					  rhs / 64];
+	return (word >> (rhs % 64)) & 1;
+}
+
+/**
+ * Lower bound of the time-window penalty of a route containing the arc
+ * (lhs, rhs). Non-zero only for infeasible arcs.
+ */
+double ALWAYS_INLINE
+arc_warp(struct customer *lhs, struct customer *rhs)
+{
+	if (!arc_infeasible_id(lhs->id, rhs->id))
+		return 0.;
+	return lhs->e + lhs->s + dist(lhs, rhs) - rhs->l;
 }
 
 #endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_DIST_H
@@ -1,6 +1,12 @@
 #include "eama_solver.h"
 
 #include "cli.h"
+#include "dist.h"
+#include "incumbent_log.h"
+#include "parallel.h"
+
+#include <math.h>
+#include <time.h>
 
 #include "core/fiber.h"
 #include "core/random.h"
@@ -17,20 +23,13 @@ const char	*RESET 	= "\033[0m",
 		*CYAN	= "\033[96m",
 		*WHITE	= "\033[97m";
 
+/** The incumbents found before are printed first */
 #define debug_print(msg, color) do {							\
+	incumbent_log_flush();										\
 	printf("%s%s: %s%s%s\n", BLUE, __func__, color, msg, RESET);\
 	fflush(stdout);												\
 } while (0)
 
-static void
-log_incumbent(struct solution *s, long elapsed_ms)
-{
-	printf("incumbent_ms: %ld n_routes: %d\n", elapsed_ms, s->n_routes);
-	fflush(stdout);
-	if (options.log_incumbent_solutions)
-		solution_print_incumbent_json(s, elapsed_ms);
-}
-
 int
 insert_feasible(struct solution *s)
 {
@@ -57,6 +56,57 @@ insert_feasible(struct solution *s)
 	return -1;
 }
 
+/** The best modification in the neighbourhood of a route */
+struct squeeze_search {
+	struct modification opt_modification;
+	double opt_delta;
+	/** The search stops once the delta is as good as this */
+	double enough_delta;
+};
+
+/** Returns true once the search can stop */
+static bool
+squeeze_search_visit(struct modification *m, void *arg)
+{
+	struct squeeze_search *search = arg;
+	/* Skip the moves that certainly can not improve the best one */
+	if (modification_delta_lower_bound(*m, eama_solver.alpha,
+					   eama_solver.beta) - EPS7 >=
+	    search->opt_delta)
+		return false;
+	double delta = modification_delta(*m, eama_solver.alpha, eama_solver.beta);
+	if (delta < search->opt_delta) {
+		search->opt_modification = *m;
+		search->opt_delta = delta;
+		if (delta <= search->enough_delta)
+			return true;
+	}
+	return false;
+}
+
+static void
+squeeze_find_opt_modification(struct solution *s, struct route *v_route,
+			      struct squeeze_search *search)
+{
+	double v_route_penalty = route_penalty(v_route, eama_solver.alpha, eama_solver.beta);
+	search->opt_modification = modification_new(INSERT, NULL, NULL);
+	search->opt_delta = INFINITY;
+	search->enough_delta = -v_route_penalty + EPS5;
+	if (options.neighbourhood == NEIGHBOURHOOD_CALLBACK) {
+		solution_modification_neighbourhood(s, v_route, options.n_near,
+						    squeeze_search_visit, search);
+		return;
+	}
+	struct modification m;
+	struct fiber *f = fiber_new(solution_modification_neighbourhood_f);
+	fiber_start(f, s, v_route, options.n_near, &m);
+	while (!fiber_is_dead(f)) {
+		if (squeeze_search_visit(&m, search))
+			fiber_cancel(f);
+		fiber_call(f);
+	}
+}
+
 int
 squeeze(struct solution *s)
 {
@@ -66,10 +116,8 @@ squeeze(struct solution *s)
 	assert(s->w != NULL);
 	assert(is_ejected(s->w));
 	assert(solution_feasible(s));
-	/* TODO: don't dup solution, instead use some persistent structure */
-	struct solution *s_dup = solution_dup(s);
+	solution_savepoint(s);
 	assert(solution_find_customer_by_id(s, s->w->id) == s->w);
-	assert(solution_find_customer_by_id(s_dup, s_dup->w->id) == s_dup->w);
 
 	modification_apply(solution_find_optimal_insertion(
 		s, s->w, eama_solver.alpha, eama_solver.beta));
@@ -86,7 +134,7 @@ squeeze(struct solution *s)
 	 * make sense.
 	 */
 	int n_infeasibles = 1;
-	static struct route *infeasibles[MAX_N_CUSTOMERS];
+	struct route **infeasibles = eama_solver.infeasibles;
 
 	assert(!route_feasible(s->w->route));
 	infeasibles[0] = s->w->route;
@@ -106,22 +154,10 @@ squeeze(struct solution *s)
 		struct route *v_route = infeasibles[route_idx];
 		assert(!route_feasible(v_route));
 
-		double v_route_penalty = route_penalty(v_route, eama_solver.alpha, eama_solver.beta);
-		struct modification opt_modification = modification_new(INSERT, NULL, NULL);
-		double opt_delta = INFINITY;
-		struct modification m;
-		struct fiber *f = fiber_new(solution_modification_neighbourhood_f);
-		fiber_start(f, s, v_route, options.n_near, &m);
-		while (!fiber_is_dead(f)) {
-			double delta = modification_delta(m, eama_solver.alpha, eama_solver.beta);
-			if (delta < opt_delta) {
-				opt_modification = m;
-				opt_delta = delta;
-				if (opt_delta <= -v_route_penalty + EPS5)
-					fiber_cancel(f);
-			}
-			fiber_call(f);
-		}
+		struct squeeze_search search;
+		squeeze_find_opt_modification(s, v_route, &search);
+		struct modification opt_modification = search.opt_modification;
+		double opt_delta = search.opt_delta;
 
 		if (options.log_level == LOGLEVEL_VERBOSE)
 			debug_print(tt_sprintf("opt modification delta: %f", opt_delta), RESET);
@@ -141,7 +177,7 @@ squeeze(struct solution *s)
 					debug_print(tt_sprintf("beta after correction: %0.12f",
 										   eama_solver.beta), RESET);
 			}
-			solution_move(s, s_dup);
+			solution_rollback_to_savepoint(s);
 			return -1;
 		}
 
@@ -183,7 +219,7 @@ squeeze(struct solution *s)
 	}
 	if (options.log_level == LOGLEVEL_VERBOSE)
 		debug_print("completed successfully", GREEN);
-	solution_delete(s_dup);
+	solution_release_savepoint(s);
 	assert(solution_feasible(s));
 	return 0;
 }
@@ -208,6 +244,8 @@ perturb(struct solution *s)
 			enum modification_type t = randint(0, EXCHANGE);
 			struct modification m = modification_new(t, v, w);
 			if (modification_applicable(m) &&
+				modification_delta_lower_bound(m, 1., 1.) -
+				EPS7 < EPS5 &&
 				modification_delta(m, 1., 1.) < EPS5) {
 				modification_apply(m);
 				++n_modifications;
@@ -220,63 +258,384 @@ perturb(struct solution *s)
 	}
 }
 
-int
-insert_eject(struct solution *s)
+/** Serial order of an insertion: the route, then the position in it */
+#define INSERT_EJECT_RANK(route, idx) \
+	((int64_t)(route) * (p.n_customers + 2) + (idx))
+
+struct insert_eject_search {
+	/** The insertion being searched and its INSERT_EJECT_RANK() */
+	struct modification insertion;
+	int64_t rank;
+	/**
+	 * The scratch of feasible_ejections() and the routes of up to
+	 * scratch_route_size positions it has room for
+	 */
+	struct customer **scratch;
+	int scratch_route_size;
+	/** The ejection being visited, see feasible_ejections() */
+	struct customer **ejection;
+	int *ejection_size;
+	/** p_best of feasible_ejections(), the p_sum of the ejection */
+	int64_t *p_best;
+	struct modification opt_insertion;
+	int64_t opt_rank;
+	int opt_ejection_size;
+	int64_t opt_p_sum;
+	/** Room for insert_eject_max_size() customers */
+	struct customer *opt_ejection[];
+};
+
+/** The largest ejection feasible_ejections() may visit */
+static int
+insert_eject_max_size(void)
 {
-	if (options.log_level == LOGLEVEL_VERBOSE)
-		debug_print("started", RESET);
+	return MAX(MIN(options.k_max, p.n_customers), 1);
+}
 
-	assert(s->w != NULL);
-	assert(is_ejected(s->w));
-	assert(solution_feasible(s));
-	/* TODO: don't dup solution, instead use some persistent structure */
-	struct solution *s_dup = solution_dup(s);
+/** feasible_ejections() only visits the ejections better than p_best */
+static bool
+insert_eject_visit(void *arg)
+{
+	struct insert_eject_search *search = arg;
+	search->opt_insertion = search->insertion;
+	search->opt_rank = search->rank;
+	for (int i = 0; i < *search->ejection_size; i++)
+		search->opt_ejection[i] = search->ejection[i];
+	search->opt_ejection_size = *search->ejection_size;
+	search->opt_p_sum = *search->p_best;
+	return false;
+}
 
-	int64_t p_best = INT64_MAX;
-	struct modification opt_insertion = modification_new(INSERT, NULL, s->w);
-	struct customer *ejection[MAX_N_CUSTOMERS];
-	int ejection_size = 0;
-	struct customer *opt_ejection[MAX_N_CUSTOMERS];
-	int opt_ejection_size = 0;
+/**
+ * Visit the feasible ejections of \a r with \a w inserted at \a idx
+ * and p_sum below *p_best
+ */
+static void
+insert_eject_enumerate(struct route *r, struct customer *w, int idx,
+		       int64_t *p_best, struct insert_eject_search *search)
+{
+	search->p_best = p_best;
+	if (r->size > search->scratch_route_size) {
+		search->scratch_route_size = r->size;
+		search->scratch = xrealloc(search->scratch,
+			sizeof(search->scratch[0]) *
+			FEASIBLE_EJECTIONS_SCRATCH_SIZE(r->size));
+	}
+	if (options.neighbourhood == NEIGHBOURHOOD_CALLBACK) {
+		feasible_ejections_insert(r, w, idx, options.k_max,
+					  eama_solver.p, search->scratch,
+					  search->ejection,
+					  search->ejection_size, p_best,
+					  insert_eject_visit, search);
+		return;
+	}
+	struct fiber *f = fiber_new(feasible_ejections_f);
+	fiber_start(f, r, w, idx, options.k_max, eama_solver.p,
+		    search->scratch, search->ejection, search->ejection_size,
+		    p_best);
+	while (!fiber_is_dead(f)) {
+		insert_eject_visit(search);
+		fiber_call(f);
+	}
+}
 
-	for (int i = 0; i < s->n_routes; i++) {
+/** Relative error the lower bounds allow for the rounding */
+#define INSERT_EJECT_BOUND_TOLERANCE 1e-9
+
+/**
+ * Data of a route for the lower bounds of the p_sum of the ejections
+ * that repair it after the insertion of w.
+ */
+struct insert_eject_bounds {
+	int64_t p_w;
+	/** The smallest p of the customers [1, i] of the route */
+	int64_t *p_min_pf;
+	/** The smallest p of the customers with a demand, w included */
+	int64_t p_min_demand;
+	/** The smallest p per unit of demand, w included */
+	double ratio_min;
+};
+
+static void
+insert_eject_bounds_init(struct insert_eject_bounds *b, struct route *r,
+			 struct customer *w)
+{
+	int64_t *p = eama_solver.p;
+	b->p_w = p[w->id];
+	b->p_min_demand = w->demand > 0. ? b->p_w : INT64_MAX;
+	b->ratio_min = w->demand > 0. ? b->p_w / w->demand : INFINITY;
+	b->p_min_pf[0] = INT64_MAX;
+	for (int i = 1; i < r->size - 1; i++) {
+		struct customer *c = r->customers[i];
+		b->p_min_pf[i] = MIN(b->p_min_pf[i - 1], p[c->id]);
+		if (c->demand > 0.) {
+			b->p_min_demand = MIN(b->p_min_demand, p[c->id]);
+			b->ratio_min = MIN(b->ratio_min, p[c->id] / c->demand);
+		}
+	}
+}
+
+/**
+ * Position of the first customer late for its time window after \a w
+ * is inserted into \a r at \a idx, or -1. The positions are the ones
+ * after the insertion, the arrival times are computed like
+ * tw_penalty does.
+ */
+static int
+insert_eject_first_late(struct route *r, struct customer *w, int idx)
+{
+	struct route_tw_data *prev = &r->tw[idx - 1];
+	double a_quote = prev->a + prev->s + dist_id(prev->id, w->id);
+	if (a_quote > w->l)
+		return idx;
+	double a = MAX(a_quote, w->e);
+	double s = w->s;
+	int id = w->id;
+	for (int i = idx; i < r->size; i++) {
+		struct route_tw_data *cur = &r->tw[i];
+		a_quote = a + s + dist_id(id, cur->id);
+		if (a_quote > cur->l)
+			return i + 1;
+		a = MAX(a_quote, cur->e);
+		/** The rest of the route is on time as before */
+		if (a == cur->a)
+			return -1;
+		s = cur->s;
+		id = cur->id;
+	}
+	return -1;
+}
+
+/**
+ * A lower bound of the p_sum of the feasible ejections after \a w is
+ * inserted into \a r at \a idx. The first late customer or one before
+ * it must be ejected, and the ejected demand must cover the excess
+ * over the vehicle capacity.
+ */
+static int64_t
+insert_eject_lower_bound(struct insert_eject_bounds *b, struct route *r,
+			 struct customer *w, int idx)
+{
+	int64_t bound = 0;
+	int late = insert_eject_first_late(r, w, idx);
+	if (late >= 0) {
+		/** The tail depot is never ejected */
+		late = MIN(late, r->size - 1);
+		bound = MIN(b->p_w, b->p_min_pf[late - 1]);
+	}
+	double excess = r->demand_pf[r->size - 1] + w->demand - p.vc;
+	if (excess > INSERT_EJECT_BOUND_TOLERANCE * p.vc) {
+		double cover = excess * b->ratio_min *
+			       (1. - INSERT_EJECT_BOUND_TOLERANCE);
+		bound = MAX(bound, b->p_min_demand);
+		bound = MAX(bound, (int64_t)ceil(cover));
+	}
+	return bound;
+}
+
+/** Routes handed to a thread at least, see insert_eject() */
+#define INSERT_EJECT_ROUTES_GRAIN 8
+
+struct insert_eject_routes_arg {
+	struct solution *s;
+	/** The smallest p_sum found by any thread so far */
+	int64_t p_best;
+	/** The search of every range, indexed by its first route */
+	struct insert_eject_search **results;
+};
+
+/** Lower the shared p_best to \a p_sum unless it is already lower */
+static void
+insert_eject_share_p_best(int64_t *p_best, int64_t p_sum)
+{
+	int64_t cur = __atomic_load_n(p_best, __ATOMIC_RELAXED);
+	while (p_sum < cur &&
+	       !__atomic_compare_exchange_n(p_best, &cur, p_sum, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/**
+ * The ejections an insertion of \a rank has to beat: the ones found
+ * by the range and the other threads. A tie is won by the earlier
+ * insertion, and the threads do not know the order of the others.
+ */
+static int64_t
+insert_eject_threshold(struct insert_eject_routes_arg *a,
+		       struct insert_eject_search *search, int64_t rank)
+{
+	int64_t own = search->opt_p_sum;
+	if (own != INT64_MAX && rank < search->opt_rank)
+		own++;
+	int64_t shared = __atomic_load_n(&a->p_best, __ATOMIC_RELAXED);
+	if (shared != INT64_MAX)
+		shared++;
+	return MIN(own, shared);
+}
+
+struct insert_eject_route {
+	int idx;
+	int64_t p_min;
+};
+
+static int
+insert_eject_route_cmp(const void *lhs, const void *rhs)
+{
+	const struct insert_eject_route *a = lhs, *b = rhs;
+	if (a->p_min != b->p_min)
+		return a->p_min < b->p_min ? -1 : 1;
+	return a->idx - b->idx;
+}
+
+/**
+ * Search the insertions into the routes [begin, end). The solution is
+ * shared between the threads: the insertions are virtual, see
+ * feasible_ejections_insert(), with a private copy of w, and only
+ * this thread touches the customers of the routes.
+ *
+ * The routes with the cheapest customers go first to find a small
+ * p_best early, the positions it cannot be beaten at are skipped. The
+ * result is still the first best insertion in the route order.
+ */
+static void
+insert_eject_routes(int begin, int end, void *arg)
+{
+	struct insert_eject_routes_arg *a = arg;
+	struct solution *s = a->s;
+	struct customer w = *s->w;
+	int64_t *ps = eama_solver.p;
+	int n = end - begin;
+	struct insert_eject_route *order = xmalloc(sizeof(order[0]) * n);
+	for (int i = 0; i < n; i++) {
+		struct route *r = s->routes[begin + i];
+		order[i].idx = begin + i;
+		order[i].p_min = ps[w.id];
+		for (int j = 1; j < r->size - 1; j++)
+			order[i].p_min = MIN(order[i].p_min,
+					     ps[r->customers[j]->id]);
+	}
+	qsort(order, n, sizeof(order[0]), insert_eject_route_cmp);
+	struct insert_eject_bounds bounds;
+	bounds.p_min_pf = xmalloc(sizeof(bounds.p_min_pf[0]) *
+				  (p.n_customers + 2));
+
+	int max_size = insert_eject_max_size();
+	struct customer **ejection = xmalloc(sizeof(ejection[0]) * max_size);
+	int ejection_size = 0;
+	struct insert_eject_search *search =
+		xmalloc(sizeof(*search) +
+			sizeof(search->opt_ejection[0]) * max_size);
+	search->scratch = NULL;
+	search->scratch_route_size = 0;
+	search->ejection = ejection;
+	search->ejection_size = &ejection_size;
+	search->opt_insertion = modification_new(INSERT, NULL, s->w);
+	search->opt_rank = INT64_MAX;
+	search->opt_ejection_size = 0;
+	search->opt_p_sum = INT64_MAX;
+
+	for (int k = 0; k < n; k++) {
+		int i = order[k].idx;
 		struct route *v_route = s->routes[i];
-		struct customer *v;
-		/* iterate over all possible insert positions in v_route */
+		/* every ejection has a customer at least */
+		if (order[k].p_min >=
+		    insert_eject_threshold(a, search, INSERT_EJECT_RANK(i, 1)))
+			continue;
+		insert_eject_bounds_init(&bounds, v_route, &w);
+		/* every position but the head depot is applicable */
 		for (int j = 1; j < v_route->size; j++) {
-			v = v_route->customers[j];
-			struct modification m = modification_new(INSERT, v, s->w);
-			if (!modification_applicable(m))
+			int64_t rank = INSERT_EJECT_RANK(i, j);
+			int64_t p_best = insert_eject_threshold(a, search, rank);
+			if (insert_eject_lower_bound(&bounds, v_route, &w, j) >=
+			    p_best)
 				continue;
-			modification_apply(m);
-
-			assert(!is_ejected(s->w));
-			assert(!route_feasible(v_route));
 			/*
 			 * iterate over all feasible ejections, looking for one
 			 * that minimizes the sum p of the ejected customers
 			 */
-			struct fiber *f = fiber_new(feasible_ejections_f);
-			fiber_start(f, v_route, options.k_max, eama_solver.p,
-				    ejection, &ejection_size, &p_best);
-			while(!fiber_is_dead(f)) {
-				opt_insertion = m;
-				for (int j = 0; j < ejection_size; j++)
-					opt_ejection[j] = ejection[j];
-				opt_ejection_size = ejection_size;
-				fiber_call(f);
-			}
-			/* roll insertion back */
-			m = modification_new(EJECT, s->w, NULL);
-			assert(modification_applicable(m));
-			modification_apply(m);
+			search->insertion = modification_new(
+				INSERT, v_route->customers[j], s->w);
+			search->rank = rank;
+			insert_eject_enumerate(v_route, &w, j, &p_best,
+					       search);
+			if (search->opt_rank == rank)
+				insert_eject_share_p_best(&a->p_best,
+							  search->opt_p_sum);
+		}
+	}
+	for (int i = 0; i < search->opt_ejection_size; i++) {
+		if (search->opt_ejection[i] == &w)
+			search->opt_ejection[i] = s->w;
+	}
+	free(search->scratch);
+	free(ejection);
+	free(bounds.p_min_pf);
+	free(order);
+	a->results[begin] = search;
+}
+
+/**
+ * Find the insertion of w and the ejection with the smallest p_sum,
+ * the first one in the route order. The routes are split between the
+ * threads, but the fibers may not leave the calling one.
+ */
+static int64_t
+insert_eject_search_routes(struct solution *s, struct modification *insertion,
+			   struct customer **ejection, int *ejection_size)
+{
+	struct insert_eject_routes_arg arg;
+	arg.s = s;
+	arg.p_best = INT64_MAX;
+	arg.results = xcalloc(s->n_routes, sizeof(arg.results[0]));
+	if (options.neighbourhood == NEIGHBOURHOOD_CALLBACK)
+		parallel_for(s->n_routes, INSERT_EJECT_ROUTES_GRAIN,
+			     insert_eject_routes, &arg);
+	else
+		insert_eject_routes(0, s->n_routes, &arg);
+	int64_t p_best = INT64_MAX;
+	*insertion = modification_new(INSERT, NULL, s->w);
+	*ejection_size = 0;
+	for (int i = 0; i < s->n_routes; i++) {
+		struct insert_eject_search *r = arg.results[i];
+		if (r == NULL)
+			continue;
+		if (r->opt_p_sum < p_best) {
+			p_best = r->opt_p_sum;
+			*insertion = r->opt_insertion;
+			memcpy(ejection, r->opt_ejection,
+			       sizeof(r->opt_ejection[0]) *
+			       r->opt_ejection_size);
+			*ejection_size = r->opt_ejection_size;
 		}
+		free(r);
 	}
+	free(arg.results);
+	return p_best;
+}
+
+int
+insert_eject(struct solution *s)
+{
 	if (options.log_level == LOGLEVEL_VERBOSE)
-		debug_print(tt_sprintf("opt insertion-ejection p_sum: %ld", p_best), RESET);
+		debug_print("started", RESET);
 
+	assert(s->w != NULL);
+	assert(is_ejected(s->w));
+	assert(solution_feasible(s));
+	solution_savepoint(s);
+
+	struct modification opt_insertion;
+	struct customer **opt_ejection =
+		xmalloc(sizeof(opt_ejection[0]) * insert_eject_max_size());
+	int opt_ejection_size;
+	int64_t p_best = insert_eject_search_routes(s, &opt_insertion,
+						    opt_ejection,
+						    &opt_ejection_size);
+	if (options.log_level == LOGLEVEL_VERBOSE)
+		debug_print(tt_sprintf("opt insertion-ejection p_sum: %ld", p_best), RESET);
 	if (opt_insertion.v == NULL && opt_ejection_size == 0) {
-		solution_move(s, s_dup);
+		free(opt_ejection);
+		solution_rollback_to_savepoint(s);
 		return -1;
 	}
 
@@ -294,43 +653,47 @@ insert_eject(struct solution *s)
 	s->w = NULL;
 	solution_check_missed_customers(s);
 
-	/*
-	 * TODO: do not update penalty after each ejection,
-	 * update it once at the end.
-	 */
-	for (int i = 0; i < opt_ejection_size; i++) {
-		struct customer *c = opt_ejection[i];
-		struct modification m = modification_new(EJECT, c, NULL);
-		assert(modification_applicable(m));
-		modification_apply(m);
-		rlist_add_tail_entry(&s->ejection_pool, c, in_eject);
-	}
+	modification_apply_ejections(opt_ejection, opt_ejection_size);
+	for (int i = 0; i < opt_ejection_size; i++)
+		solution_ejection_pool_push(s, opt_ejection[i]);
+	free(opt_ejection);
 
 	if (options.log_level == LOGLEVEL_VERBOSE)
 		debug_print("completed successfully", GREEN);
-	solution_delete(s_dup);
+	solution_release_savepoint(s);
 	assert(solution_feasible(s));
 	solution_check_missed_customers(s);
 	return 0;
 }
 
+/**
+ * Milliseconds of the monotonic clock. The time limit is the wall
+ * time: the CPU time of clock() grows faster with the threads.
+ */
+static int64_t
+eama_solver_clock_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 int
-delete_route(struct solution *s, clock_t deadline)
+delete_route(struct solution *s, int64_t deadline_ms)
 {
 	if (options.log_level == LOGLEVEL_VERBOSE)
 		debug_print("started", RESET);
 
 	assert(rlist_empty(&s->ejection_pool));
 	assert(solution_feasible(s));
-	/* TODO: don't dup solution, instead use some persistent structure */
-	struct solution *s_dup = solution_dup(s);
+	solution_savepoint(s);
 	solution_eliminate_random_route(s);
 	assert(solution_feasible(s));
 	solution_check_missed_customers(s);
 
 	while (!rlist_empty(&s->ejection_pool)) {
 		/** This will only be executed once during the entire execution time */
-		if (unlikely(clock() >= deadline))
+		if (unlikely(eama_solver_clock_ms() >= deadline_ms))
 			goto fail;
 
 		if (options.log_level == LOGLEVEL_VERBOSE) {
@@ -340,9 +703,7 @@ delete_route(struct solution *s, clock_t deadline)
 			debug_print(tt_sprintf("ejection_pool: %d", n_ejected), RESET);
 		}
 		/** remove v from EP with the LIFO strategy */
-		s->w = rlist_last_entry(
-			&s->ejection_pool, struct customer, in_eject);
-		rlist_del_entry(s->w, in_eject);
+		s->w = solution_ejection_pool_pop(s);
 
 		assert(solution_find_customer_by_id(s, s->w->id) == s->w);
 
@@ -367,12 +728,24 @@ delete_route(struct solution *s, clock_t deadline)
 	fail:
 		if (options.log_level == LOGLEVEL_VERBOSE)
 			debug_print("failed", RED);
-		solution_move(s, s_dup);
+		solution_rollback_to_savepoint(s);
 		return -1;
 	}
+#if DISTANCE_MATRIX_FLOAT
+	/*
+	 * The search has only seen rounded distances, so the new incumbent
+	 * must also survive the full-precision check to be accepted.
+	 */
+	if (!solution_feasible_exact(s)) {
+		if (options.log_level == LOGLEVEL_VERBOSE)
+			debug_print("infeasible under full-precision distances", RED);
+		solution_rollback_to_savepoint(s);
+		return -1;
+	}
+#endif
 	if (options.log_level == LOGLEVEL_VERBOSE)
 		debug_print("completed successfully", GREEN);
-	solution_delete(s_dup);
+	solution_release_savepoint(s);
 	return 0;
 }
 
@@ -382,17 +755,21 @@ eama_solver_solve(void)
 	if (options.log_level >= LOGLEVEL_NORMAL)
 		debug_print("started", RESET);
 
+	parallel_start();
 	eama_solver.alpha = eama_solver.beta = 1.;
-	memset(&eama_solver.p[0], 0, sizeof(eama_solver.p));
+	eama_solver.p = xcalloc(p.n_customers + 1, sizeof(eama_solver.p[0]));
+	eama_solver.infeasibles = xmalloc(sizeof(eama_solver.infeasibles[0]) *
+					  p.n_customers);
 
 	/* Compute deadline with sub-second precision when --t_max_ms is used */
-	clock_t start_clock = clock();
-	clock_t deadline;
+	int64_t start_ms = eama_solver_clock_ms();
+	int64_t deadline_ms;
 	if (options.has_t_max_ms)
-		deadline = start_clock +
-			   (clock_t)((double)options.t_max_ms / 1000.0 * CLOCKS_PER_SEC);
+		deadline_ms = start_ms + options.t_max_ms;
 	else
-		deadline = start_clock + CLOCKS_PER_SEC * options.t_max;
+		deadline_ms = start_ms + (int64_t)options.t_max * 1000;
+
+	solution_set_tw_neighbours(options.neighbours == NEIGHBOURS_TIME_WINDOWS);
 
 	int lower_bound = MAX(problem_routes_straight_lower_bound(),
 			      options.lower_bound);
@@ -406,12 +783,13 @@ eama_solver_solve(void)
 	solution_check_missed_customers(s);
 
 	/* Log initial incumbent at t=0 */
-	log_incumbent(s, 0);
+	incumbent_log_start(options.log_incumbent_solutions);
+	incumbent_log_push(s, 0);
 
 	while (s->n_routes > lower_bound) {
 		if (options.log_level >= LOGLEVEL_NORMAL)
 			debug_print(tt_sprintf("routes number: %d", s->n_routes), PURPLE);
-		if (delete_route(s, deadline) != 0)
+		if (delete_route(s, deadline_ms) != 0)
 			break;
 		assert(rlist_empty(&s->ejection_pool));
 		assert(s->w == NULL);
@@ -419,11 +797,15 @@ eama_solver_solve(void)
 		assert(rlist_empty(&s->ejection_pool));
 
 		/* Log incumbent after successful route deletion */
-		clock_t now = clock();
-		long elapsed_ms = (long)((double)(now - start_clock) /
-					 CLOCKS_PER_SEC * 1000.0);
-		log_incumbent(s, elapsed_ms);
+		long elapsed_ms = (long)(eama_solver_clock_ms() - start_ms);
+		incumbent_log_push(s, elapsed_ms);
 	}
+	incumbent_log_stop();
+	free(eama_solver.infeasibles);
+	free(eama_solver.p);
+	eama_solver.infeasibles = NULL;
+	eama_solver.p = NULL;
+	parallel_stop();
 	assert(s->w == NULL);
 	assert(rlist_empty(&s->ejection_pool));
 	if (options.log_level >= LOGLEVEL_NORMAL)
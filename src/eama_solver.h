@@ -15,7 +15,9 @@ struct eama_solver {
     double alpha;
     double beta;
     /* TODO: make `p` a member of class `customer` */
-    int64_t p[MAX_N_CUSTOMERS];
+    int64_t *p;
+    /** Scratch of squeeze(), room for a route per customer */
+    struct route **infeasibles;
 };
 
 extern struct eama_solver eama_solver;
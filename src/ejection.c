@@ -7,48 +7,109 @@
 
 #define DEBUG_ASSERT_NEAR(lhs, rhs) assert(fabs((lhs)-(rhs)) < 1e-5)
 
-void init_a_earliest(struct route *r) {
+/**
+ * Load the data of \a r the enumeration needs into its customers and
+ * push them but the head depot onto \a s, the first one on top.
+ * Returns the number of the pushed customers.
+ */
+static int
+feasible_ejections_load(struct route *r, struct customer **s)
+{
 	struct customer *prev = depot_head(r);
 	prev->a_earliest = prev->e;
+	prev->ejection_idx = 0;
 	for (int i = 1; i < r->size; i++) {
 		struct customer *next = r->customers[i];
-		next->a_earliest = MAX(next->e, prev->a + prev->s + dist(prev, next));
-		assert(next->a == MIN(next->a_earliest, next->l));
+		next->a_earliest = MAX(next->e, r->tw[i - 1].a + prev->s + dist(prev, next));
+		assert(r->tw[i].a == MIN(next->a_earliest, next->l));
+		next->ejection_idx = i;
+		next->ejection_z = r->tw[i].z;
+		next->ejection_tw_sf = r->tw[i].tw_sf;
+		s[r->size - 1 - i] = next;
 		prev = next;
 	}
+	return r->size - 1;
 }
 
-int
-feasible_ejections_f(va_list ap)
+/**
+ * Same as feasible_ejections_load() for \a r with \a w inserted at
+ * \a idx. The values are the ones route_insert_customer() followed by
+ * route_update_penalty() would compute, bit for bit, but the route is
+ * not touched: the prefix values are computed along with a_earliest,
+ * the suffix ones change only up to w.
+ */
+static int
+feasible_ejections_load_insert(struct route *r, struct customer *w, int idx,
+			       struct customer **s, double *total_demand)
 {
-	struct route *r = va_arg(ap, struct route *);
-	int k_max = va_arg(ap, int);
-	int64_t *ps = va_arg(ap, int64_t *);
-	struct customer **e = va_arg(ap, struct customer **);
-	int *e_size_out = va_arg(ap, int *);
-	int64_t *p_best = va_arg(ap, int64_t *);
-
-	if (k_max <= 0)
-		return 0;
+	assert(idx > 0 && idx < r->size);
+	int size = r->size + 1;
+	struct customer *prev = depot_head(r);
+	prev->a_earliest = prev->e;
+	prev->ejection_idx = 0;
+	double a = r->tw[0].a;
+	*total_demand = r->demand_pf[idx - 1];
+	for (int i = 1; i < size; i++) {
+		struct customer *next = i < idx ? r->customers[i] :
+					i == idx ? w : r->customers[i - 1];
+		next->a_earliest = MAX(next->e, a + prev->s + dist(prev, next));
+		next->ejection_idx = i;
+		if (i < idx) {
+			a = r->tw[i].a;
+		} else {
+			a = MIN(next->a_earliest, next->l);
+			*total_demand += next->demand;
+		}
+		if (i > idx) {
+			next->ejection_z = r->tw[i - 1].z;
+			next->ejection_tw_sf = r->tw[i - 1].tw_sf;
+		}
+		s[size - 1 - i] = next;
+		prev = next;
+	}
+	/** See tw_penalty_update_backward_from() */
+	struct customer *next = r->customers[idx];
+	double z = r->tw[idx].z;
+	double tw_sf = r->tw[idx].tw_sf;
+	for (int i = idx; i >= 0; i--) {
+		struct customer *cur = i == idx ? w : r->customers[i];
+		double z_quote = z - cur->s - dist(cur, next);
+		z = MIN(MAX(z_quote, cur->e), cur->l);
+		tw_sf += MAX(0., cur->e - z_quote);
+		cur->ejection_z = z;
+		cur->ejection_tw_sf = tw_sf;
+		if (i < idx && z == r->tw[i].z) {
+			double offset = tw_sf - r->tw[i].tw_sf;
+			for (int j = i - 1; j >= 0; j--) {
+				cur = r->customers[j];
+				cur->ejection_z = r->tw[j].z;
+				cur->ejection_tw_sf = r->tw[j].tw_sf + offset;
+			}
+			break;
+		}
+		next = cur;
+	}
+	return size - 1;
+}
 
-	struct customer *ne[MAX_N_CUSTOMERS + 2];
-	struct customer *s[MAX_N_CUSTOMERS + 2];
-	int ne_size = 1, s_size = 0;
-	struct customer *ne_last = depot_head(r);
+/**
+ * Enumerate the ejections of the customers loaded onto \a s, see
+ * feasible_ejections_load(), after the head depot \a head. \a ne has
+ * room for the head and the loaded customers.
+ */
+static void
+feasible_ejections_from(struct customer *head, struct customer **s,
+			int s_size, struct customer **ne, double total_demand,
+			int k_max, int64_t *ps, struct customer **e,
+			int *e_size_out, int64_t *p_best,
+			feasible_ejections_visitor_f visit, void *visit_arg)
+{
+	int ne_size = 1;
+	struct customer *ne_last = head;
 	ne[0] = ne_last;
 	ne_last->a_temp = ne_last->a_earliest_temp = ne_last->e;
 	*e_size_out = 0;
 
-	init_a_earliest(r);
-
-	struct customer *tmp;
-	route_foreach_from(tmp, route_next(ne_last))
-		s[s_size++] = tmp;
-	for (int i = 0; i < s_size / 2; i++)
-		SWAP(s[i], s[s_size - 1 - i]);
-
-	double total_demand;
-	total_demand = depot_tail(r)->demand_pf;
 	bool capacity_violated = total_demand > p.vc;
 
 	int64_t p_sum = 0;
@@ -66,15 +127,13 @@ feasible_ejections_f(va_list ap)
 		if (/** Is better than current optimum */
 		    p_sum < *p_best &&
 		    /** Doesn't violate time-window constraint */
-		    s_first->a_earliest_temp <= s_first->l && s_first->a_temp <= s_first->z && s_first->tw_sf == 0. &&
+		    s_first->a_earliest_temp <= s_first->l && s_first->a_temp <= s_first->ejection_z && s_first->ejection_tw_sf == 0. &&
 		    /** Doesn't violate capacity constraint */
 		    total_demand <= p.vc) {
 			*p_best = p_sum;
 
-			fiber_yield();
-
-			if (fiber_is_cancelled())
-				return 0;
+			if (visit(visit_arg))
+				return;
 		}
 
 		if (s_first->id != 0) {
@@ -94,7 +153,7 @@ feasible_ejections_f(va_list ap)
 
 			if (unlikely(k == 1)) {
 				*e_size_out = 0;
-				return 0;
+				return;
 			}
 
 			e_last = e[*e_size_out - 1];
@@ -104,7 +163,7 @@ feasible_ejections_f(va_list ap)
 
 			while (ne_size > 0) {
 				ne_last = ne[ne_size - 1];
-				if (ne_last->idx <= e_last->idx)
+				if (ne_last->ejection_idx <= e_last->ejection_idx)
 					break;
 				/**
 				 * Let's ignore that s_first becomes irrelevant.
@@ -159,3 +218,69 @@ feasible_ejections_f(va_list ap)
 	}
 	unreachable();
 }
+
+void
+feasible_ejections(struct route *r, int k_max, int64_t *ps,
+		   struct customer **scratch, struct customer **e,
+		   int *e_size_out, int64_t *p_best,
+		   feasible_ejections_visitor_f visit, void *visit_arg)
+{
+	if (k_max <= 0)
+		return;
+	/* the stack and the non-ejected customers */
+	struct customer **s = scratch;
+	int s_size = feasible_ejections_load(r, s);
+	feasible_ejections_from(depot_head(r), s, s_size, s + r->size,
+				r->demand_pf[r->size - 1], k_max, ps, e,
+				e_size_out, p_best, visit, visit_arg);
+}
+
+void
+feasible_ejections_insert(struct route *r, struct customer *w, int idx,
+			  int k_max, int64_t *ps, struct customer **scratch,
+			  struct customer **e, int *e_size_out, int64_t *p_best,
+			  feasible_ejections_visitor_f visit, void *visit_arg)
+{
+	if (k_max <= 0)
+		return;
+	/* the stack and the non-ejected customers, w included */
+	struct customer **s = scratch;
+	double total_demand;
+	int s_size = feasible_ejections_load_insert(r, w, idx, s,
+						    &total_demand);
+	feasible_ejections_from(depot_head(r), s, s_size, s + r->size + 1,
+				total_demand, k_max, ps, e, e_size_out, p_best,
+				visit, visit_arg);
+}
+
+/** Pass the ejection to the caller of the fiber */
+static bool
+feasible_ejections_yield(void *arg)
+{
+	(void)arg;
+	fiber_yield();
+	return fiber_is_cancelled();
+}
+
+int
+feasible_ejections_f(va_list ap)
+{
+	struct route *r = va_arg(ap, struct route *);
+	struct customer *w = va_arg(ap, struct customer *);
+	int idx = va_arg(ap, int);
+	int k_max = va_arg(ap, int);
+	int64_t *ps = va_arg(ap, int64_t *);
+	struct customer **scratch = va_arg(ap, struct customer **);
+	struct customer **e = va_arg(ap, struct customer **);
+	int *e_size_out = va_arg(ap, int *);
+	int64_t *p_best = va_arg(ap, int64_t *);
+	if (w == NULL) {
+		feasible_ejections(r, k_max, ps, scratch, e, e_size_out,
+				   p_best, feasible_ejections_yield, NULL);
+	} else {
+		feasible_ejections_insert(r, w, idx, k_max, ps, scratch, e,
+					  e_size_out, p_best,
+					  feasible_ejections_yield, NULL);
+	}
+	return 0;
+}
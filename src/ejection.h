@@ -2,6 +2,11 @@
 #define EAMA_ROUTES_MINIMIZATION_HEURISTIC_INSERT_EJECT_H
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct customer;
+struct route;
 
 /**
  * Based on article "A powerful route minimization heuristic for the vehicle
@@ -16,7 +21,24 @@
 	 */				\
 	double a_temp;			\
 	double a_earliest_temp;	\
-	double a_earliest
+	double a_earliest;		\
+	/** Position and suffix values in the route being searched */	\
+	int ejection_idx;		\
+	double ejection_z;		\
+	double ejection_tw_sf
+
+/**
+ * Room feasible_ejections() and feasible_ejections_insert() need in
+ * their scratch for a route of \a size positions, depots included
+ */
+#define FEASIBLE_EJECTIONS_SCRATCH_SIZE(size) (2 * ((size) + 1))
+
+/**
+ * Visitor of feasible_ejections(). The ejection is only valid during
+ * the call. Returns true to stop the enumeration.
+ */
+typedef bool
+(*feasible_ejections_visitor_f)(void *arg);
 
 /**
  * @brief Iterate over feasible ejections (a subsets of route customers such
@@ -28,9 +50,35 @@
  *
  * @param r 		route
  * @param k_max		maximum subset size
+ * @param scratch	room for FEASIBLE_EJECTIONS_SCRATCH_SIZE(r->size)
+ *			customers, reused between the calls
  * @param e		output array for current ejection
  * @param e_size	output size of current ejection
  * @param p_best	current minimum sum of p
+ * @param visit		called for every ejection found, after p_best
+ *			is set to its sum of p
+ */
+void
+feasible_ejections(struct route *r, int k_max, int64_t *ps,
+		   struct customer **scratch, struct customer **e,
+		   int *e_size, int64_t *p_best,
+		   feasible_ejections_visitor_f visit, void *visit_arg);
+
+/**
+ * Same as feasible_ejections() for \a r with \a w inserted at \a idx,
+ * i.e. before the customer at \a idx. The route is only read, so the
+ * insertion costs no more than the enumeration itself.
+ */
+void
+feasible_ejections_insert(struct route *r, struct customer *w, int idx,
+			  int k_max, int64_t *ps, struct customer **scratch,
+			  struct customer **e, int *e_size, int64_t *p_best,
+			  feasible_ejections_visitor_f visit, void *visit_arg);
+
+/**
+ * Fiber version of feasible_ejections_insert(), takes the same
+ * arguments but the visitor and yields for every ejection. \a w may be
+ * NULL to search the route as is. Cancel the fiber to stop.
  */
 int
 feasible_ejections_f(va_list ap);
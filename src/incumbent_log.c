@@ -0,0 +1,216 @@
+#include "incumbent_log.h"
+
+#include <semaphore.h>
+#include <signal.h>
+
+#include "outbuf.h"
+#include "problem.h"
+#include "utils.h"
+
+#include "tt_pthread.h"
+
+/** The routes of an incumbent, a node of the queue */
+struct incumbent_snapshot {
+	struct incumbent_snapshot *next;
+	long elapsed_ms;
+	int n_routes;
+	double cost;
+	/** Number of customers of every route */
+	int *sizes;
+	/** The customers of the routes in order, the depots omitted */
+	int *ids;
+};
+
+/**
+ * Unbounded single-producer single-consumer queue of the snapshots.
+ * The consumer keeps the last node it has printed as `head` and
+ * publishes it, the producer recycles the nodes before it, so the
+ * memory stays bounded by the longest backlog.
+ */
+static struct {
+	bool json;
+	pthread_t thread;
+	/** Posted once per pushed snapshot and once on stop */
+	sem_t ready;
+	/** Posted once per printed snapshot */
+	sem_t printed;
+	bool stopping;
+	/** Owned by the producer */
+	struct incumbent_snapshot *tail;
+	struct incumbent_snapshot *first;
+	struct incumbent_snapshot *head_copy;
+	/** Written by the consumer only */
+	struct incumbent_snapshot *head;
+} incumbent_log;
+
+static struct incumbent_snapshot *
+incumbent_snapshot_new(void)
+{
+	struct incumbent_snapshot *snapshot = xmalloc(sizeof(*snapshot));
+	snapshot->next = NULL;
+	snapshot->sizes = xmalloc(sizeof(int) * p.n_customers);
+	snapshot->ids = xmalloc(sizeof(int) * p.n_customers);
+	return snapshot;
+}
+
+static void
+incumbent_snapshot_delete(struct incumbent_snapshot *snapshot)
+{
+	free(snapshot->sizes);
+	free(snapshot->ids);
+	free(snapshot);
+}
+
+/** A node the consumer is done with, or a new one */
+static struct incumbent_snapshot *
+incumbent_log_alloc(void)
+{
+	if (incumbent_log.first == incumbent_log.head_copy)
+		incumbent_log.head_copy = __atomic_load_n(&incumbent_log.head,
+							  __ATOMIC_ACQUIRE);
+	if (incumbent_log.first == incumbent_log.head_copy)
+		return incumbent_snapshot_new();
+	struct incumbent_snapshot *snapshot = incumbent_log.first;
+	incumbent_log.first = snapshot->next;
+	snapshot->next = NULL;
+	return snapshot;
+}
+
+static void
+incumbent_log_format(struct outbuf *b, struct incumbent_snapshot *snapshot,
+		     bool json)
+{
+	outbuf_str(b, "incumbent_ms: ");
+	outbuf_int(b, snapshot->elapsed_ms);
+	outbuf_str(b, " n_routes: ");
+	outbuf_int(b, snapshot->n_routes);
+	outbuf_char(b, '\n');
+	if (!json)
+		return;
+	outbuf_str(b, "incumbent_solution_json: {\"elapsed_ms\":");
+	outbuf_int(b, snapshot->elapsed_ms);
+	outbuf_str(b, ",\"num_routes\":");
+	outbuf_int(b, snapshot->n_routes);
+	outbuf_str(b, ",\"native_cost\":");
+	outbuf_fixed(b, snapshot->cost, 12);
+	outbuf_str(b, ",\"routes\":[");
+	const int *id = snapshot->ids;
+	for (int i = 0; i < snapshot->n_routes; i++) {
+		if (i > 0)
+			outbuf_char(b, ',');
+		outbuf_char(b, '[');
+		for (int j = 0; j < snapshot->sizes[i]; j++) {
+			if (j > 0)
+				outbuf_char(b, ',');
+			outbuf_int(b, *id++);
+		}
+		outbuf_char(b, ']');
+	}
+	outbuf_str(b, "]}\n");
+}
+
+static void *
+incumbent_log_f(void *arg)
+{
+	(void)arg;
+	struct outbuf b;
+	outbuf_create(&b);
+	for (;;) {
+		while (sem_wait(&incumbent_log.ready) != 0)
+			;
+		struct incumbent_snapshot *next =
+			__atomic_load_n(&incumbent_log.head->next,
+					__ATOMIC_ACQUIRE);
+		if (next == NULL) {
+			/** Woken up by the stop with the queue drained */
+			assert(__atomic_load_n(&incumbent_log.stopping,
+					       __ATOMIC_ACQUIRE));
+			break;
+		}
+		incumbent_log_format(&b, next, incumbent_log.json);
+		/**
+		 * Go through stdio, so the lines of the solver thread are
+		 * never mixed into a record.
+		 */
+		flockfile(stdout);
+		fwrite(b.data, 1, b.size, stdout);
+		fflush(stdout);
+		funlockfile(stdout);
+		outbuf_reset(&b);
+		__atomic_store_n(&incumbent_log.head, next, __ATOMIC_RELEASE);
+		sem_post(&incumbent_log.printed);
+	}
+	outbuf_destroy(&b);
+	return NULL;
+}
+
+void
+incumbent_log_start(bool json)
+{
+	incumbent_log.json = json;
+	incumbent_log.stopping = false;
+	struct incumbent_snapshot *dummy = incumbent_snapshot_new();
+	incumbent_log.tail = dummy;
+	incumbent_log.first = dummy;
+	incumbent_log.head_copy = dummy;
+	incumbent_log.head = dummy;
+	if (sem_init(&incumbent_log.ready, 0, 0) != 0 ||
+	    sem_init(&incumbent_log.printed, 0, 0) != 0)
+		panic("Cannot create a semaphore.");
+	if (tt_pthread_create(&incumbent_log.thread, NULL, incumbent_log_f,
+			      NULL) != 0)
+		panic("Cannot create a thread.");
+}
+
+void
+incumbent_log_push(struct solution *s, long elapsed_ms)
+{
+	struct incumbent_snapshot *snapshot = incumbent_log_alloc();
+	snapshot->elapsed_ms = elapsed_ms;
+	snapshot->n_routes = s->n_routes;
+	snapshot->cost = incumbent_log.json ? solution_routing_cost(s) : 0.;
+	int *id = snapshot->ids;
+	for (int i = 0; i < s->n_routes; i++) {
+		struct route *r = s->routes[i];
+		snapshot->sizes[i] = r->size - 2;
+		for (int j = 1; j < r->size - 1; j++)
+			*id++ = r->customers[j]->id;
+	}
+	assert(id - snapshot->ids <= p.n_customers);
+	__atomic_store_n(&incumbent_log.tail->next, snapshot, __ATOMIC_RELEASE);
+	incumbent_log.tail = snapshot;
+	sem_post(&incumbent_log.ready);
+}
+
+void
+incumbent_log_flush(void)
+{
+	if (incumbent_log.tail == NULL)
+		return;
+	/**
+	 * Every snapshot not printed yet posts once more, the posts of
+	 * the ones printed before the call only cause extra checks.
+	 */
+	while (__atomic_load_n(&incumbent_log.head, __ATOMIC_ACQUIRE) !=
+	       incumbent_log.tail)
+		while (sem_wait(&incumbent_log.printed) != 0)
+			;
+}
+
+void
+incumbent_log_stop(void)
+{
+	__atomic_store_n(&incumbent_log.stopping, true, __ATOMIC_RELEASE);
+	sem_post(&incumbent_log.ready);
+	tt_pthread_join(incumbent_log.thread, NULL);
+	sem_destroy(&incumbent_log.ready);
+	sem_destroy(&incumbent_log.printed);
+	struct incumbent_snapshot *snapshot = incumbent_log.first;
+	while (snapshot != NULL) {
+		struct incumbent_snapshot *next = snapshot->next;
+		incumbent_snapshot_delete(snapshot);
+		snapshot = next;
+	}
+	incumbent_log.tail = incumbent_log.first = NULL;
+	incumbent_log.head_copy = incumbent_log.head = NULL;
+}
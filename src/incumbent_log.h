@@ -0,0 +1,43 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_INCUMBENT_LOG_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_INCUMBENT_LOG_H
+
+#include <stdbool.h>
+
+#include "solution.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Start the thread printing the incumbents to stdout, with their
+ * routes as JSON lines if \a json is set.
+ */
+void
+incumbent_log_start(bool json);
+
+/**
+ * Queue a snapshot of the routes of \a s for the logger thread. Never
+ * blocks: the queue grows while the output lags behind, so every
+ * incumbent is printed, in the order of the calls.
+ */
+void
+incumbent_log_push(struct solution *s, long elapsed_ms);
+
+/**
+ * Wait until the queued incumbents are printed, so that the lines
+ * printed next go after them. Does nothing if the thread is not
+ * started.
+ */
+void
+incumbent_log_flush(void);
+
+/** Wait until the queued incumbents are printed and stop the thread */
+void
+incumbent_log_stop(void);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_INCUMBENT_LOG_H
@@ -30,6 +30,7 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include <assert.h>
 #include <stddef.h>
 #include "small/rlist.h"
 
@@ -58,11 +59,22 @@ struct rlist_assign_op {
     struct rlist in_history;
 };
 
+/**
+ * Allocate and free an operation. A program using this header defines
+ * both, e.g. with malloc() or a mempool, so all of its translation
+ * units share one allocator whatever they include.
+ */
+struct rlist_assign_op *
+rlist_assign_op_alloc(void);
+
+void
+rlist_assign_op_free(struct rlist_assign_op *op);
+
 static SMALL_ALWAYS_INLINE struct rlist_assign_op *
 rlist_assign_op_new(struct rlist **var, struct rlist *prev_val,
 	struct rlist *next_val)
 {
-	struct rlist_assign_op *op = malloc(sizeof(*op)); //TODO: use mempool
+	struct rlist_assign_op *op = rlist_assign_op_alloc();
 	op->var = var;
 	op->prev_val = prev_val;
 	op->next_val = next_val;
@@ -73,7 +85,7 @@ rlist_assign_op_new(struct rlist **var, struct rlist *prev_val,
 static SMALL_ALWAYS_INLINE void
 rlist_assign_op_delete(struct rlist_assign_op *op)
 {
-	free(op); //TODO: return back to mempool
+	rlist_assign_op_free(op);
 }
 
 static SMALL_ALWAYS_INLINE rlist_persistent_svp
@@ -98,6 +110,19 @@ rlist_persistent_rollback_to_svp(rlist_persistent_history *history,
 	assert(history == &svp->in_history);
 }
 
+/**
+ * Forget all operations keeping the current state. No savepoint
+ * created before can be rolled back to after this.
+ */
+static SMALL_ALWAYS_INLINE void
+rlist_persistent_forget_history(rlist_persistent_history *history)
+{
+	struct rlist_assign_op *op, *tmp;
+	rlist_foreach_entry_safe(op, history, in_history, tmp)
+		rlist_assign_op_delete(op);
+	rlist_create(history);
+}
+
 #define rlist_assign(x, y) do {						\
 	struct rlist_assign_op *op = rlist_assign_op_new(&x, x, y); 	\
 	rlist_add_tail_entry(history, op, in_history);                 	\
@@ -3,6 +3,18 @@
 
 #define ITEMS		7
 
+struct rlist_assign_op *
+rlist_assign_op_alloc(void)
+{
+	return malloc(sizeof(struct rlist_assign_op));
+}
+
+void
+rlist_assign_op_free(struct rlist_assign_op *op)
+{
+	free(op);
+}
+
 struct test {
     int no;
     struct rlist list;
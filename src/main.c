@@ -1,5 +1,8 @@
 #include "cli.h"
 #include "eama_solver.h"
+#include "parallel.h"
+#include "pools.h"
+#include "problem_cache.h"
 #include "problem_decode.h"
 #include "solution_encode.h"
 
@@ -13,21 +16,32 @@ main(int argc, const char *argv[])
 	parse_arguments(argc, argv);
 
 	memory_init();
+	pools_init();
 	fiber_init(fiber_c_invoke);
 	random_init();
 	if (options.has_seed)
 		pseudo_random_seed(options.seed);
 
-	problem_decode(options.problem_file);
+	parallel_set_n_threads(options.n_threads);
+	if (options.cache_dir != NULL)
+		problem_cache_decode(options.problem_file, options.cache_dir,
+				     options.n_near, options.neighbours ==
+				     NEIGHBOURS_TIME_WINDOWS);
+	else
+		problem_decode(options.problem_file);
 
 	struct solution *s = eama_solver_solve();
 	printf("n_routes: %d\n", s->n_routes);
 	fflush(stdout);
 	solution_check_missed_customers(s);
-	solution_encode(s, options.solution_file);
+	if (options.binary_solution)
+		solution_encode_binary(s, options.solution_file);
+	else
+		solution_encode(s, options.solution_file);
 	solution_delete(s);
 	problem_destroy();
 
+	pools_free();
 	memory_free();
 	return 0;
 }
@@ -1,5 +1,6 @@
 #include "modification.h"
 
+#include "dist.h"
 #include "penalty_inline.h"
 #include "route.h"
 
@@ -74,27 +75,44 @@ modification_apply(struct modification m)
 	v_route = m.v->route;
 	/** Possible only in the case of EJECT */
 	w_route = (m.w == NULL) ? NULL : m.w->route;
+	route_journal_touch(v_route);
+	if (w_route != NULL)
+		route_journal_touch(w_route);
 	switch (m.type) {
 	case TWO_OPT: {
 		int v_cut = m.v->idx + 1;
 		int w_cut = m.w->idx + 1;
 		int v_tail_len = v_route->size - v_cut;
 		int w_tail_len = w_route->size - w_cut;
-		struct customer *v_tail[MAX_N_CUSTOMERS + 2];
-		struct customer *w_tail[MAX_N_CUSTOMERS + 2];
-		memcpy(v_tail, &v_route->customers[v_cut],
-		       sizeof(v_tail[0]) * v_tail_len);
-		memcpy(w_tail, &w_route->customers[w_cut],
-		       sizeof(w_tail[0]) * w_tail_len);
-		memcpy(&v_route->customers[v_cut], w_tail,
-		       sizeof(w_tail[0]) * w_tail_len);
-		memcpy(&w_route->customers[w_cut], v_tail,
-		       sizeof(v_tail[0]) * v_tail_len);
+		route_reserve(v_route, v_cut + w_tail_len);
+		route_reserve(w_route, w_cut + v_tail_len);
+		struct customer **v_tail = &v_route->customers[v_cut];
+		struct customer **w_tail = &w_route->customers[w_cut];
+		/* swap the common part, then move the rest of the longer tail */
+		int common_len = MIN(v_tail_len, w_tail_len);
+		for (int i = 0; i < common_len; i++)
+			SWAP(v_tail[i], w_tail[i]);
+		if (v_tail_len > common_len)
+			memcpy(&w_tail[common_len], &v_tail[common_len],
+			       sizeof(v_tail[0]) * (v_tail_len - common_len));
+		else
+			memcpy(&v_tail[common_len], &w_tail[common_len],
+			       sizeof(w_tail[0]) * (w_tail_len - common_len));
 		v_route->size = v_cut + w_tail_len;
 		w_route->size = w_cut + v_tail_len;
 		route_refresh_metadata_from(v_route, v_cut);
 		route_refresh_metadata_from(w_route, w_cut);
-		break;
+		/*
+		 * The penalty data of the tails stayed in place, so
+		 * the tails are recomputed as a whole.
+		 */
+		route_update_penalty(v_route, v_route->customers[v_cut],
+				     depot_tail(v_route));
+		route_update_penalty(w_route, w_route->customers[w_cut],
+				     depot_tail(w_route));
+		route_check(v_route);
+		route_check(w_route);
+		return;
 	}
 	case OUT_RELOCATE: {
 		struct customer *source_forward = route_next(m.w);
@@ -113,7 +131,10 @@ modification_apply(struct modification m)
 			--dst_idx;
 		route_insert_customer(v_route, dst_idx, m.w);
 		if (v_route == w_route) {
-			route_init_penalty(v_route);
+			/** The customers between w's old and new place moved */
+			route_update_penalty(v_route,
+				v_route->customers[MIN(src_idx, dst_idx)],
+				v_route->customers[MAX(src_idx, dst_idx)]);
 			route_check(v_route);
 			return;
 		}
@@ -136,7 +157,9 @@ modification_apply(struct modification m)
 		else
 			route_refresh_metadata_from(w_route, w_idx);
 		if (v_route == w_route) {
-			route_init_penalty(v_route);
+			route_update_penalty(v_route,
+				v_route->customers[MIN(v_idx, w_idx)],
+				v_route->customers[MAX(v_idx, w_idx)]);
 			route_check(v_route);
 			return;
 		}
@@ -173,16 +196,21 @@ modification_apply(struct modification m)
 	default:
 		unreachable();
 	}
-	/*
-	 * TODO: do not iterate over all route to update penalties.
-	 * The prefix up to the first customer remained unchanged.
-	 * If the value `a` of a customer is unchanged, then the
-	 * suffix starting from this customer is also unchanged.
-	 */
-	route_init_penalty(v_route);
-	route_init_penalty(w_route);
-	route_check(v_route);
-	route_check(w_route);
+}
+
+void
+modification_apply_ejections(struct customer **cs, int n)
+{
+	if (n == 0)
+		return;
+	struct route *r = cs[0]->route;
+	route_journal_touch(r);
+	/** The customers between the first and the last ejected one */
+	int first = cs[0]->idx;
+	int last = cs[n - 1]->idx - n;
+	route_remove_customers(r, cs, n);
+	route_update_penalty(r, r->customers[first], r->customers[last]);
+	route_check(r);
 }
 
 double
@@ -228,3 +256,51 @@ modification_delta(struct modification m, double alpha, double beta)
 	}
 	return alpha * m.c_penalty_delta + beta * m.tw_penalty_delta;
 }
+
+double
+modification_delta_lower_bound(struct modification m, double alpha,
+			       double beta)
+{
+	assert(modification_applicable(m));
+	struct route *v_route = m.v->route;
+	struct route *w_route = m.w == NULL ? NULL : m.w->route;
+	/*
+	 * The heads of the new arcs are distinct, and every one of them
+	 * adds at least the warp of its arc to the penalty of its route.
+	 */
+	double warp;
+	switch (m.type) {
+	case TWO_OPT:
+		warp = arc_warp(m.v, route_next(m.w)) +
+		       arc_warp(m.w, route_next(m.v));
+		break;
+	case OUT_RELOCATE:
+		if (v_route == w_route)
+			return -INFINITY;
+		warp = arc_warp(route_prev(m.v), m.w) + arc_warp(m.w, m.v) +
+		       arc_warp(route_prev(m.w), route_next(m.w));
+		break;
+	case EXCHANGE:
+		if (v_route == w_route)
+			return -INFINITY;
+		warp = arc_warp(route_prev(m.v), m.w) +
+		       arc_warp(m.w, route_next(m.v)) +
+		       arc_warp(route_prev(m.w), m.v) +
+		       arc_warp(m.v, route_next(m.w));
+		break;
+	case INSERT:
+		warp = arc_warp(route_prev(m.v), m.w) + arc_warp(m.w, m.v);
+		break;
+	default:
+		return -INFINITY;
+	}
+	if (warp == 0.)
+		return -INFINITY;
+	double lower_bound = beta * warp -
+		alpha * c_penalty_get_penalty_inline(v_route) -
+		beta * tw_penalty_get_penalty_inline(v_route);
+	if (w_route != NULL)
+		lower_bound -= alpha * c_penalty_get_penalty_inline(w_route) +
+			beta * tw_penalty_get_penalty_inline(w_route);
+	return lower_bound;
+}
@@ -37,9 +37,26 @@ modification_applicable(struct modification m);
 void
 modification_apply(struct modification m);
 
+/**
+ * Same as EJECT modifications of the customers \a cs of one route,
+ * given in the route order, but the route is compacted and its
+ * penalty is updated once.
+ */
+void
+modification_apply_ejections(struct customer **cs, int n);
+
 double
 modification_delta(struct modification m, double alpha, double beta);
 
+/**
+ * A lower bound of modification_delta() from the infeasible arcs the
+ * modification creates, see problem::infeasible_arcs. It takes a bitmap
+ * lookup per new arc, -INFINITY when none of them is infeasible.
+ */
+double
+modification_delta_lower_bound(struct modification m, double alpha,
+			       double beta);
+
 #if defined(__cplusplus)
 }
 #endif /* defined(__cplusplus) */
@@ -0,0 +1,382 @@
+#include "neighbours.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parallel.h"
+
+/** Average number of customers in a cell of the grid */
+#define NEIGHBOURS_GRID_CELL_LOAD 2
+
+/** Minimal number of rows worth a thread of neighbours_init_rows() */
+#define NEIGHBOURS_INIT_ROWS_GRAIN 64
+
+/**
+ * Weights of the waiting time and of the time warp in the
+ * relatedness measure of Vidal et al. "A hybrid genetic algorithm with
+ * adaptive diversity management for a large class of vehicle routing
+ * problems with time-windows".
+ */
+#define NEIGHBOURS_WAIT_WEIGHT 0.2
+#define NEIGHBOURS_WARP_WEIGHT 1.
+
+static struct {
+	int k;
+	bool tw;
+	/** Set if the rows are attached, see neighbours_attach() */
+	bool attached;
+	/** Row of the customer with id i starts at i * k */
+	int *rows;
+} neighbours;
+
+/**
+ * Uniform grid of square cells over the bounding box of the customers.
+ * The customers of cell (x, y) are
+ * ids[start[y * nx + x] .. start[y * nx + x + 1]).
+ */
+struct neighbours_grid {
+	double x0, y0;
+	double cell;
+	int nx, ny;
+	int *start;
+	int *ids;
+};
+
+/** Candidate of a row, ordered by key, then by id */
+struct neighbour {
+	double key;
+	int id;
+};
+
+static inline bool
+neighbour_less(const struct neighbour *a, const struct neighbour *b)
+{
+	return a->key < b->key || (a->key == b->key && a->id < b->id);
+}
+
+static int
+neighbour_cmp(const void *lhs, const void *rhs)
+{
+	const struct neighbour *a = lhs, *b = rhs;
+	return neighbour_less(a, b) ? -1 : neighbour_less(b, a) ? 1 : 0;
+}
+
+/**
+ * Bounded max-heap keeping the k least candidates pushed so far,
+ * the greatest of them on top.
+ */
+struct neighbour_heap {
+	int size;
+	int k;
+	struct neighbour *data;
+};
+
+static void
+neighbour_heap_push(struct neighbour_heap *h, double key, int id)
+{
+	struct neighbour e = { .key = key, .id = id };
+	struct neighbour *d = h->data;
+	int i;
+	if (h->size < h->k) {
+		/** Sift up */
+		i = h->size++;
+		while (i > 0 && neighbour_less(&d[(i - 1) / 2], &e)) {
+			d[i] = d[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+		d[i] = e;
+		return;
+	}
+	if (!neighbour_less(&e, &d[0]))
+		return;
+	/** Replace the top and sift down */
+	i = 0;
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= h->size)
+			break;
+		if (child + 1 < h->size &&
+		    neighbour_less(&d[child], &d[child + 1]))
+			child++;
+		if (!neighbour_less(&e, &d[child]))
+			break;
+		d[i] = d[child];
+		i = child;
+	}
+	d[i] = e;
+}
+
+/** Sort the candidates of the heap into \a row */
+static void
+neighbour_heap_flush(struct neighbour_heap *h, int *row)
+{
+	qsort(h->data, h->size, sizeof(h->data[0]), neighbour_cmp);
+	for (int i = 0; i < h->size; i++)
+		row[i] = h->data[i].id;
+	h->size = 0;
+}
+
+/**
+ * Time warp of the trip from a to b of length \a d when a is served at
+ * its earliest
+ */
+static double
+neighbours_warp(struct customer *a, struct customer *b, double d)
+{
+	return MAX(0., a->e + a->s + d - b->l);
+}
+
+/** Waiting time at b after a trip of length \a d from a served at its latest */
+static double
+neighbours_wait(struct customer *a, struct customer *b, double d)
+{
+	return MAX(0., b->e - a->l - a->s - d);
+}
+
+/**
+ * Relatedness of a and b, adjacent in the best of the two orders. A pair
+ * that can not be adjacent in a feasible route gets at least its time
+ * warp added, which ranks it behind the compatible pairs nearby.
+ */
+static double
+neighbours_relatedness(struct customer *a, struct customer *b)
+{
+	double d_ab = problem_customer_distance(a, b);
+	double d_ba = problem_customer_distance(b, a);
+	double ab = d_ab +
+		NEIGHBOURS_WAIT_WEIGHT * neighbours_wait(a, b, d_ab) +
+		NEIGHBOURS_WARP_WEIGHT * neighbours_warp(a, b, d_ab);
+	double ba = d_ba +
+		NEIGHBOURS_WAIT_WEIGHT * neighbours_wait(b, a, d_ba) +
+		NEIGHBOURS_WARP_WEIGHT * neighbours_warp(b, a, d_ba);
+	return MIN(ab, ba);
+}
+
+/**
+ * The key of b in the row of a, the only one all the rows are ranked
+ * by, see neighbours_key()
+ */
+static inline double
+neighbours_rank_key(struct customer *a, struct customer *b, bool tw)
+{
+	return tw && a != p.depot ? neighbours_relatedness(a, b) :
+	       problem_customer_distance(a, b);
+}
+
+static inline int
+neighbours_grid_coord(double v, double v0, double cell, int n)
+{
+	int i = (int)((v - v0) / cell);
+	return MAX(0, MIN(i, n - 1));
+}
+
+static void
+neighbours_grid_create(struct neighbours_grid *g, struct customer **cs,
+		       int n)
+{
+	double x0 = cs[1]->x, x1 = cs[1]->x;
+	double y0 = cs[1]->y, y1 = cs[1]->y;
+	for (int i = 2; i <= n; i++) {
+		x0 = MIN(x0, cs[i]->x);
+		x1 = MAX(x1, cs[i]->x);
+		y0 = MIN(y0, cs[i]->y);
+		y1 = MAX(y1, cs[i]->y);
+	}
+	double w = x1 - x0, h = y1 - y0;
+	g->cell = sqrt(w * h * NEIGHBOURS_GRID_CELL_LOAD / n);
+	/** The customers are on a line or at a single point */
+	if (!(g->cell > 0))
+		g->cell = MAX(w, h) * NEIGHBOURS_GRID_CELL_LOAD / n;
+	if (!(g->cell > 0))
+		g->cell = 1.;
+	g->x0 = x0;
+	g->y0 = y0;
+	g->nx = MIN((int)(w / g->cell) + 1, n);
+	g->ny = MIN((int)(h / g->cell) + 1, n);
+
+	/** Counting sort of the customers by cell */
+	int n_cells = g->nx * g->ny;
+	g->start = xcalloc(n_cells + 1, sizeof(g->start[0]));
+	g->ids = xmalloc(sizeof(g->ids[0]) * n);
+	int *cell_of = xmalloc(sizeof(cell_of[0]) * (n + 1));
+	for (int i = 1; i <= n; i++) {
+		int cx = neighbours_grid_coord(cs[i]->x, x0, g->cell, g->nx);
+		int cy = neighbours_grid_coord(cs[i]->y, y0, g->cell, g->ny);
+		cell_of[i] = cy * g->nx + cx;
+		g->start[cell_of[i] + 1]++;
+	}
+	for (int i = 0; i < n_cells; i++)
+		g->start[i + 1] += g->start[i];
+	int *pos = xmalloc(sizeof(pos[0]) * n_cells);
+	memcpy(pos, g->start, sizeof(pos[0]) * n_cells);
+	for (int i = 1; i <= n; i++)
+		g->ids[pos[cell_of[i]]++] = i;
+	free(pos);
+	free(cell_of);
+}
+
+static void
+neighbours_grid_destroy(struct neighbours_grid *g)
+{
+	free(g->start);
+	free(g->ids);
+}
+
+static void
+neighbours_grid_push_cell(struct neighbours_grid *g, struct customer **cs,
+			  struct customer *c, int cx, int cy,
+			  struct neighbour_heap *h)
+{
+	if (cx < 0 || cx >= g->nx || cy < 0 || cy >= g->ny)
+		return;
+	int cell = cy * g->nx + cx;
+	for (int i = g->start[cell]; i < g->start[cell + 1]; i++) {
+		int id = g->ids[i];
+		neighbour_heap_push(h, neighbours_rank_key(c, cs[id], false),
+				    id);
+	}
+}
+
+/**
+ * Collect the nearest customers of c into the heap, scanning the rings
+ * of cells around the cell of c until no customer of the rings left
+ * can be nearer than the farthest one collected.
+ */
+static void
+neighbours_grid_search(struct neighbours_grid *g, struct customer **cs,
+		       struct customer *c, struct neighbour_heap *h)
+{
+	int cx = neighbours_grid_coord(c->x, g->x0, g->cell, g->nx);
+	int cy = neighbours_grid_coord(c->y, g->y0, g->cell, g->ny);
+	int max_ring = MAX(g->nx, g->ny);
+	neighbours_grid_push_cell(g, cs, c, cx, cy, h);
+	for (int r = 1; r <= max_ring; r++) {
+		/**
+		 * The cells of ring r are at least r - 1 cells away from
+		 * c, even if c is outside of the grid. The slack covers
+		 * the rounding of the cell coordinates.
+		 */
+		if (h->size == h->k &&
+		    (r - 1) * g->cell > h->data[0].key + EPS5)
+			break;
+		for (int d = -r; d <= r; d++) {
+			neighbours_grid_push_cell(g, cs, c, cx + d, cy - r, h);
+			neighbours_grid_push_cell(g, cs, c, cx + d, cy + r, h);
+		}
+		for (int d = -r + 1; d <= r - 1; d++) {
+			neighbours_grid_push_cell(g, cs, c, cx - r, cy + d, h);
+			neighbours_grid_push_cell(g, cs, c, cx + r, cy + d, h);
+		}
+	}
+}
+
+struct neighbours_init_rows_arg {
+	struct customer **cs;
+	/** NULL if the distances are explicit, the rows are scanned then */
+	struct neighbours_grid *g;
+	bool tw;
+};
+
+/** Build the rows [begin, end), the depot row included if begin is 0 */
+static void
+neighbours_init_rows(int begin, int end, void *arg)
+{
+	struct neighbours_init_rows_arg *a = arg;
+	struct customer **cs = a->cs;
+	int n = p.n_customers;
+	int k = neighbours.k;
+	struct neighbour_heap h = {
+		.size = 0,
+		.k = k,
+		.data = xmalloc(sizeof(struct neighbour) * k),
+	};
+	for (int i = begin; i < end; i++) {
+		if ((!a->tw || i == 0) && a->g != NULL) {
+			neighbours_grid_search(a->g, cs, cs[i], &h);
+		} else {
+			for (int j = 1; j <= n; j++)
+				neighbour_heap_push(&h, neighbours_rank_key(
+					cs[i], cs[j], a->tw), j);
+		}
+		neighbour_heap_flush(&h, &neighbours.rows[i * k]);
+	}
+	free(h.data);
+}
+
+void
+neighbours_init(int k, bool tw)
+{
+	int n = p.n_customers;
+	assert(n > 0);
+	k = MAX(1, MIN(k, n));
+	struct customer **cs = xmalloc(sizeof(cs[0]) * (n + 1));
+	cs[0] = p.depot;
+	struct customer *c;
+	rlist_foreach_entry(c, &p.customers, in_route)
+		cs[c->id] = c;
+
+	neighbours_free();
+	neighbours.k = k;
+	neighbours.tw = tw;
+	neighbours.rows = xmalloc(sizeof(neighbours.rows[0]) * k * (n + 1));
+	/** The coordinates say nothing of the explicit distances */
+	struct neighbours_grid g;
+	if (!p.explicit_distances)
+		neighbours_grid_create(&g, cs, n);
+	struct neighbours_init_rows_arg arg = {
+		.cs = cs,
+		.g = p.explicit_distances ? NULL : &g,
+		.tw = tw,
+	};
+	parallel_for(n + 1, NEIGHBOURS_INIT_ROWS_GRAIN, neighbours_init_rows,
+		     &arg);
+	if (!p.explicit_distances)
+		neighbours_grid_destroy(&g);
+	free(cs);
+}
+
+void
+neighbours_attach(const int *rows, int k, bool tw)
+{
+	neighbours_free();
+	neighbours.k = k;
+	neighbours.tw = tw;
+	neighbours.attached = true;
+	neighbours.rows = (int *)rows;
+}
+
+void
+neighbours_free(void)
+{
+	if (!neighbours.attached)
+		free(neighbours.rows);
+	neighbours.rows = NULL;
+	neighbours.k = 0;
+	neighbours.attached = false;
+}
+
+bool
+neighbours_ready(int k, bool tw)
+{
+	return neighbours.rows != NULL && neighbours.tw == tw &&
+	       neighbours.k >= MIN(k, p.n_customers);
+}
+
+double
+neighbours_key(struct customer *a, struct customer *b)
+{
+	return neighbours_rank_key(a, b, neighbours.tw);
+}
+
+int
+neighbours_k(void)
+{
+	return neighbours.k;
+}
+
+const int *
+neighbours_row(int id)
+{
+	return &neighbours.rows[id * neighbours.k];
+}
@@ -0,0 +1,64 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_NEIGHBOURS_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_NEIGHBOURS_H
+
+#include <stdbool.h>
+
+#include "problem.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Build the neighbour lists of the problem: for the depot and for every
+ * customer, the ids of its \a k nearest customers (the depot is never a
+ * neighbour), closest first, ties broken by id. A customer is its own
+ * neighbour as well.
+ *
+ * The nearest customers are found with a uniform grid over the
+ * coordinates, so the setup takes O(n * k) instead of sorting n rows
+ * of n customers. If \a tw is set, the customer rows are ranked by the
+ * time-window relatedness of the pairs instead of the distance, which
+ * still takes O(n^2) relatedness evaluations. The depot row is always
+ * ranked by the distance. The rows are built by parallel_for().
+ */
+void
+neighbours_init(int k, bool tw);
+
+/**
+ * Use the \a rows built by neighbours_init(k, tw) elsewhere, e.g. mapped
+ * from a file, until the next neighbours_init() or neighbours_free().
+ * The rows are not copied nor freed.
+ */
+void
+neighbours_attach(const int *rows, int k, bool tw);
+
+void
+neighbours_free(void);
+
+/** Whether the rows are built with neighbours_init(k' >= k, tw) */
+bool
+neighbours_ready(int k, bool tw);
+
+/**
+ * The key b is ranked by in the row of the customer a built by the last
+ * neighbours_init(): the time-window relatedness or
+ * problem_customer_distance(), also in the single precision mode. The
+ * row lists its customers in the order of (key, id).
+ */
+double
+neighbours_key(struct customer *a, struct customer *b);
+
+/** Length of the rows built by the last neighbours_init() */
+int
+neighbours_k(void);
+
+/** Neighbour list of the customer (or of the depot) with \a id */
+const int *
+neighbours_row(int id);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_NEIGHBOURS_H
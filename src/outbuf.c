@@ -0,0 +1,257 @@
+#include "outbuf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#include "core/say.h"
+
+/** Initial capacity, enough for most of the incumbent lines */
+#define OUTBUF_MIN_CAPACITY 4096
+
+/** Decimals outbuf_fixed() rounds itself, 10^18 * 2^53 fits 128 bits */
+#define OUTBUF_MAX_DECIMALS 18
+
+/** Significant digits of the "%g" format */
+#define OUTBUF_G_PRECISION 6
+
+/** Products of a 53-bit mantissa and a power of 10 */
+__extension__ typedef unsigned __int128 outbuf_uint128_t;
+
+static const uint64_t outbuf_pow10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+};
+
+void
+outbuf_create(struct outbuf *b)
+{
+	b->data = NULL;
+	b->size = 0;
+	b->capacity = 0;
+}
+
+void
+outbuf_destroy(struct outbuf *b)
+{
+	free(b->data);
+	outbuf_create(b);
+}
+
+char *
+outbuf_reserve(struct outbuf *b, size_t size)
+{
+	if (b->size + size > b->capacity) {
+		size_t capacity = MAX(b->capacity, OUTBUF_MIN_CAPACITY);
+		while (capacity < b->size + size)
+			capacity *= 2;
+		b->data = xrealloc(b->data, capacity);
+		b->capacity = capacity;
+	}
+	return b->data + b->size;
+}
+
+void
+outbuf_str(struct outbuf *b, const char *s)
+{
+	outbuf_append(b, s, strlen(s));
+}
+
+/** Append the decimal digits of v, at least \a min_digits of them */
+static void
+outbuf_uint(struct outbuf *b, uint64_t v, int min_digits)
+{
+	char digits[24];
+	int n = 0;
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v != 0);
+	while (n < min_digits)
+		digits[n++] = '0';
+	char *pos = outbuf_reserve(b, n);
+	for (int i = 0; i < n; i++)
+		pos[i] = digits[n - 1 - i];
+	b->size += n;
+}
+
+void
+outbuf_int(struct outbuf *b, long long v)
+{
+	if (v < 0) {
+		outbuf_char(b, '-');
+		outbuf_uint(b, -(unsigned long long)v, 1);
+	} else {
+		outbuf_uint(b, v, 1);
+	}
+}
+
+/**
+ * Round a * 10^decimals to an integer, ties to even, like printf()
+ * rounds the exact binary value. a must be finite, non-negative and
+ * a * 10^decimals below 2^63.
+ */
+static uint64_t
+outbuf_round_scaled(double a, int decimals)
+{
+	assert(decimals >= 0 && decimals <= OUTBUF_MAX_DECIMALS);
+	if (a == 0.)
+		return 0;
+	int exp;
+	/** a = m * 2^e exactly */
+	uint64_t m = (uint64_t)ldexp(frexp(a, &exp), 53);
+	int e = exp - 53;
+	outbuf_uint128_t n = (outbuf_uint128_t)m * outbuf_pow10[decimals];
+	if (e >= 0)
+		return (uint64_t)(n << e);
+	int shift = -e;
+	/** n < 2^113, so it is below the half of 2^shift */
+	if (shift >= 128)
+		return 0;
+	outbuf_uint128_t q = n >> shift;
+	outbuf_uint128_t rem = n - (q << shift);
+	outbuf_uint128_t half = (outbuf_uint128_t)1 << (shift - 1);
+	if (rem > half || (rem == half && (q & 1) != 0))
+		q++;
+	return (uint64_t)q;
+}
+
+/** Append q / 10^decimals with exactly \a decimals digits after '.' */
+static void
+outbuf_scaled(struct outbuf *b, uint64_t q, int decimals)
+{
+	uint64_t scale = outbuf_pow10[decimals];
+	outbuf_uint(b, q / scale, 1);
+	if (decimals > 0) {
+		outbuf_char(b, '.');
+		outbuf_uint(b, q % scale, decimals);
+	}
+}
+
+/**
+ * Whether v is +0 or -0. The bits are tested: the -Ofast programs run
+ * with the denormals treated as zeros by the arithmetic.
+ */
+static bool
+outbuf_double_is_zero(double v)
+{
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	return (bits << 1) == 0;
+}
+
+static void
+outbuf_printf_double(struct outbuf *b, const char *format, int decimals,
+		     double v)
+{
+	char buf[512];
+	int len = snprintf(buf, sizeof(buf), format, decimals, v);
+	assert(len >= 0);
+	if (len < (int)sizeof(buf)) {
+		outbuf_append(b, buf, len);
+		return;
+	}
+	/** Huge "%f" numbers */
+	snprintf(outbuf_reserve(b, len + 1), len + 1, format, decimals, v);
+	b->size += len;
+}
+
+void
+outbuf_fixed(struct outbuf *b, double v, int decimals)
+{
+	double a = fabs(v);
+	if (!isfinite(v) || decimals < 0 || decimals > OUTBUF_MAX_DECIMALS ||
+	    a >= 9e18 / outbuf_pow10[decimals]) {
+		outbuf_printf_double(b, "%.*f", decimals, v);
+		return;
+	}
+	if (signbit(v))
+		outbuf_char(b, '-');
+	outbuf_scaled(b, outbuf_round_scaled(a, decimals), decimals);
+}
+
+void
+outbuf_double(struct outbuf *b, double v)
+{
+	double a = fabs(v);
+	/** The "%g" fixed notation is for the exponents in [-4, 6) */
+	bool is_zero = outbuf_double_is_zero(v);
+	if (!isfinite(v) || (!is_zero && (a < 1e-5 || a >= 1e7))) {
+		outbuf_printf_double(b, "%.*g", OUTBUF_G_PRECISION, v);
+		return;
+	}
+	if (is_zero) {
+		outbuf_str(b, signbit(v) ? "-0" : "0");
+		return;
+	}
+	/**
+	 * Guess the decimal exponent x of a, then fix it by the number of
+	 * digits of a rounded to the precision: a may be rounded up to the
+	 * next power of 10, and the powers of 10 below 1 are inexact.
+	 */
+	int x = -5;
+	while (x < 6 && a >= outbuf_pow10[x + 5] / 1e5)
+		x++;
+	x--;
+	uint64_t q;
+	for (;;) {
+		if (x < -4 || x >= OUTBUF_G_PRECISION) {
+			outbuf_printf_double(b, "%.*g", OUTBUF_G_PRECISION, v);
+			return;
+		}
+		q = outbuf_round_scaled(a, OUTBUF_G_PRECISION - 1 - x);
+		if (q >= outbuf_pow10[OUTBUF_G_PRECISION])
+			x++;
+		else if (q < outbuf_pow10[OUTBUF_G_PRECISION - 1])
+			x--;
+		else
+			break;
+	}
+	/** "%g" drops the trailing zeros of the fraction */
+	int decimals = OUTBUF_G_PRECISION - 1 - x;
+	while (decimals > 0 && q % 10 == 0) {
+		q /= 10;
+		decimals--;
+	}
+	if (signbit(v))
+		outbuf_char(b, '-');
+	outbuf_scaled(b, q, decimals);
+}
+
+void
+outbuf_write_fd(struct outbuf *b, int fd)
+{
+	size_t written = 0;
+	while (written < b->size) {
+		ssize_t n = write(fd, b->data + written, b->size - written);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			panic("outbuf: cannot write: %s", strerror(errno));
+		written += n;
+	}
+	outbuf_reset(b);
+}
+
+void
+outbuf_write_file(struct outbuf *b, const char *file)
+{
+	int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		panic("outbuf: cannot create file '%s': %s", file,
+		      strerror(errno));
+	outbuf_write_fd(b, fd);
+	if (close(fd) != 0)
+		panic("outbuf: cannot write file '%s': %s", file,
+		      strerror(errno));
+}
@@ -0,0 +1,84 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_OUTBUF_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_OUTBUF_H
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Growable output buffer. The output is formatted into it and written
+ * with a single write(2), the buffer keeps its memory for the next one.
+ */
+struct outbuf {
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+void
+outbuf_create(struct outbuf *b);
+
+void
+outbuf_destroy(struct outbuf *b);
+
+static inline void
+outbuf_reset(struct outbuf *b)
+{
+	b->size = 0;
+}
+
+/** Grow the buffer to fit \a size more bytes, returns the free space */
+char *
+outbuf_reserve(struct outbuf *b, size_t size);
+
+static inline void
+outbuf_append(struct outbuf *b, const void *data, size_t size)
+{
+	memcpy(outbuf_reserve(b, size), data, size);
+	b->size += size;
+}
+
+static inline void
+outbuf_char(struct outbuf *b, char c)
+{
+	*outbuf_reserve(b, 1) = c;
+	b->size++;
+}
+
+void
+outbuf_str(struct outbuf *b, const char *s);
+
+void
+outbuf_int(struct outbuf *b, long long v);
+
+/**
+ * Append \a v like printf("%.*f", decimals, v) does, byte for byte.
+ * The usual magnitudes are rounded exactly in integer arithmetic, the
+ * rest goes to snprintf().
+ */
+void
+outbuf_fixed(struct outbuf *b, double v, int decimals);
+
+/**
+ * Append \a v like printf("%g", v) and std::ostream do, byte for
+ * byte, see outbuf_fixed().
+ */
+void
+outbuf_double(struct outbuf *b, double v);
+
+/** Write the whole buffer to \a fd and reset it, panics on errors */
+void
+outbuf_write_fd(struct outbuf *b, int fd);
+
+/** Replace the contents of \a file with the buffer and reset it */
+void
+outbuf_write_file(struct outbuf *b, const char *file);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_OUTBUF_H
@@ -0,0 +1,186 @@
+#include "parallel.h"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+#include "tt_pthread.h"
+
+/** Hard limit of parallel_set_n_threads() */
+#define PARALLEL_MAX_THREADS 256
+
+static int parallel_n_threads = 1;
+
+struct parallel_range {
+	pthread_t thread;
+	int begin;
+	int end;
+	parallel_range_f f;
+	void *arg;
+};
+
+/**
+ * The threads of parallel_start(). The worker i runs ranges[i] of
+ * every parallel_for() with more than i ranges, the calling thread
+ * runs ranges[0]. The mutex is locked with the plain pthread calls,
+ * the tt_pthread ones log every lock at the debug level.
+ */
+static struct parallel_pool {
+	bool started;
+	bool stopping;
+	pthread_mutex_t mutex;
+	/** Signalled when a parallel_for() is posted or on the stop */
+	pthread_cond_t work_cond;
+	/** Signalled when the last worker finishes its range */
+	pthread_cond_t done_cond;
+	/** The number of the parallel_for() calls posted so far */
+	uint64_t generation;
+	int n_ranges;
+	/** The workers that have not finished their range yet */
+	int n_running;
+	struct parallel_range ranges[PARALLEL_MAX_THREADS];
+} parallel_pool;
+
+static void *
+parallel_range_f_thread(void *arg)
+{
+	struct parallel_range *r = arg;
+	r->f(r->begin, r->end, r->arg);
+	return NULL;
+}
+
+static void *
+parallel_pool_worker_f(void *arg)
+{
+	struct parallel_pool *pool = &parallel_pool;
+	int i = (int)(intptr_t)arg;
+	uint64_t generation = 0;
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->generation == generation && !pool->stopping)
+			tt_pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		if (pool->stopping)
+			break;
+		generation = pool->generation;
+		if (i >= pool->n_ranges)
+			continue;
+		struct parallel_range *r = &pool->ranges[i];
+		pthread_mutex_unlock(&pool->mutex);
+		r->f(r->begin, r->end, r->arg);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->n_running == 0)
+			tt_pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+void
+parallel_set_n_threads(int n_threads)
+{
+	if (n_threads < 1 || n_threads > PARALLEL_MAX_THREADS)
+		panic("The number of threads must be in [1, %d], got %d.",
+		      PARALLEL_MAX_THREADS, n_threads);
+	assert(!parallel_pool.started);
+	parallel_n_threads = n_threads;
+}
+
+void
+parallel_start(void)
+{
+	struct parallel_pool *pool = &parallel_pool;
+	assert(!pool->started);
+	pool->started = true;
+	pool->stopping = false;
+	pool->generation = 0;
+	pool->n_ranges = 0;
+	pool->n_running = 0;
+	tt_pthread_mutex_init(&pool->mutex, NULL);
+	tt_pthread_cond_init(&pool->work_cond, NULL);
+	tt_pthread_cond_init(&pool->done_cond, NULL);
+	for (int i = 1; i < parallel_n_threads; i++) {
+		if (tt_pthread_create(&pool->ranges[i].thread, NULL,
+				      parallel_pool_worker_f,
+				      (void *)(intptr_t)i) != 0)
+			panic("Cannot create a thread.");
+	}
+}
+
+void
+parallel_stop(void)
+{
+	struct parallel_pool *pool = &parallel_pool;
+	assert(pool->started);
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	tt_pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (int i = 1; i < parallel_n_threads; i++)
+		tt_pthread_join(pool->ranges[i].thread, NULL);
+	tt_pthread_cond_destroy(&pool->done_cond);
+	tt_pthread_cond_destroy(&pool->work_cond);
+	tt_pthread_mutex_destroy(&pool->mutex);
+	pool->started = false;
+}
+
+/** Split [0, n) into \a n_ranges contiguous ranges */
+static void
+parallel_split(struct parallel_range *ranges, int n_ranges, int n,
+	       parallel_range_f f, void *arg)
+{
+	for (int i = 0; i < n_ranges; i++) {
+		ranges[i].begin = (int)((int64_t)n * i / n_ranges);
+		ranges[i].end = (int)((int64_t)n * (i + 1) / n_ranges);
+		ranges[i].f = f;
+		ranges[i].arg = arg;
+	}
+}
+
+/** parallel_for() on the threads of parallel_start() */
+static void
+parallel_pool_for(int n_ranges, int n, parallel_range_f f, void *arg)
+{
+	struct parallel_pool *pool = &parallel_pool;
+	pthread_mutex_lock(&pool->mutex);
+	assert(pool->n_running == 0);
+	parallel_split(pool->ranges, n_ranges, n, f, arg);
+	pool->n_ranges = n_ranges;
+	pool->n_running = n_ranges - 1;
+	pool->generation++;
+	tt_pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	f(pool->ranges[0].begin, pool->ranges[0].end, arg);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->n_running > 0)
+		tt_pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+parallel_for(int n, int grain, parallel_range_f f, void *arg)
+{
+	int n_ranges = MIN(parallel_n_threads, n / MAX(grain, 1));
+	if (n_ranges <= 1) {
+		if (n > 0)
+			f(0, n, arg);
+		return;
+	}
+	if (parallel_pool.started) {
+		parallel_pool_for(n_ranges, n, f, arg);
+		return;
+	}
+	struct parallel_range ranges[PARALLEL_MAX_THREADS];
+	parallel_split(ranges, n_ranges, n, f, arg);
+	for (int i = 1; i < n_ranges; i++) {
+		if (tt_pthread_create(&ranges[i].thread, NULL,
+				      parallel_range_f_thread, &ranges[i]) != 0)
+			panic("Cannot create a thread.");
+	}
+	f(ranges[0].begin, ranges[0].end, arg);
+	for (int i = 1; i < n_ranges; i++)
+		tt_pthread_join(ranges[i].thread, NULL);
+}
@@ -0,0 +1,46 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_PARALLEL_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_PARALLEL_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Process the items [begin, end) of a parallel_for() */
+typedef void
+(*parallel_range_f)(int begin, int end, void *arg);
+
+/**
+ * Set the number of threads parallel_for() runs on, including the
+ * calling one. 1 by default.
+ */
+void
+parallel_set_n_threads(int n_threads);
+
+/**
+ * Start the threads of parallel_for(), they wait for the ranges until
+ * parallel_stop(). Without them every parallel_for() creates and joins
+ * its own threads, which is only fine for the calls of the
+ * preprocessing. The number of threads may not change in between.
+ */
+void
+parallel_start(void);
+
+/** Join the threads of parallel_start() */
+void
+parallel_stop(void);
+
+/**
+ * Split [0, n) into contiguous ranges of at least \a grain items and
+ * run \a f on them, one range per thread, the calling thread included.
+ * Returns when all the ranges are processed. The ranges must be
+ * independent: \a f may not touch the fibers, the regions or the
+ * pseudo-random generator of the caller.
+ */
+void
+parallel_for(int n, int grain, parallel_range_f f, void *arg);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_PARALLEL_H
@@ -9,16 +9,17 @@
 static ALWAYS_INLINE double
 tw_penalty_get_penalty_inline(struct route *r)
 {
-	return depot_tail(r)->tw_pf;
+	return r->tw[r->size - 1].tw_pf;
 }
 
+/** Penalty of the route with \a w inserted between \a prev and \a next */
 static ALWAYS_INLINE double
-tw_penalty_get_insert_penalty_inline(struct customer *v, struct customer *w)
+tw_penalty_insert_between_inline(struct route_tw_data *prev,
+				 struct route_tw_data *next, struct customer *w)
 {
-	struct customer *v_minus = route_prev(v);
-	double p_tw = v_minus->tw_pf + v->tw_sf;
-	double a_quote_w = v_minus->a + v_minus->s + dist(v_minus, w);
-	double z_quote_w = v->z - w->s - dist(w, v);
+	double p_tw = prev->tw_pf + next->tw_sf;
+	double a_quote_w = prev->a + prev->s + dist_id(prev->id, w->id);
+	double z_quote_w = next->z - w->s - dist_id(w->id, next->id);
 	p_tw += MAX(0., a_quote_w - w->l);
 	p_tw += MAX(0., w->e - z_quote_w);
 	double a_w = MIN(MAX(a_quote_w, w->e), w->l);
@@ -27,6 +28,13 @@ tw_penalty_get_insert_penalty_inline(struct customer *v, struct customer *w)
 	return p_tw;
 }
 
+static ALWAYS_INLINE double
+tw_penalty_get_insert_penalty_inline(struct customer *v, struct customer *w)
+{
+	return tw_penalty_insert_between_inline(&v->route->tw[v->idx - 1],
+						&v->route->tw[v->idx], w);
+}
+
 static ALWAYS_INLINE double
 tw_penalty_get_insert_delta_inline(struct customer *v, struct customer *w)
 {
@@ -37,11 +45,11 @@ tw_penalty_get_insert_delta_inline(struct customer *v, struct customer *w)
 static ALWAYS_INLINE double
 tw_penalty_get_replace_penalty_inline(struct customer *v, struct customer *w)
 {
-	struct customer *v_minus = route_prev(v);
-	struct customer *v_plus = route_next(v);
+	struct route_tw_data *v_minus = &v->route->tw[v->idx - 1];
+	struct route_tw_data *v_plus = &v->route->tw[v->idx + 1];
 	double p_tw = v_minus->tw_pf + v_plus->tw_sf;
-	double a_quote_v = v_minus->a + v_minus->s + dist(v_minus, w);
-	double z_quote_v = v_plus->z - w->s - dist(w, v_plus);
+	double a_quote_v = v_minus->a + v_minus->s + dist_id(v_minus->id, w->id);
+	double z_quote_v = v_plus->z - w->s - dist_id(w->id, v_plus->id);
 	p_tw += MAX(0., a_quote_v - w->l);
 	p_tw += MAX(0., w->e - z_quote_v);
 	double a_v = MIN(MAX(a_quote_v, w->e), w->l);
@@ -60,10 +68,11 @@ tw_penalty_get_replace_delta_inline(struct customer *v, struct customer *w)
 static ALWAYS_INLINE double
 tw_penalty_get_eject_penalty_inline(struct customer *v)
 {
-	struct customer *v_minus = route_prev(v);
-	struct customer *v_plus = route_next(v);
+	struct route_tw_data *v_minus = &v->route->tw[v->idx - 1];
+	struct route_tw_data *v_plus = &v->route->tw[v->idx + 1];
 	double p_tw = v_minus->tw_pf + v_plus->tw_sf;
-	double a_quote_v_plus = v_minus->a + v_minus->s + dist(v_minus, v_plus);
+	double a_quote_v_plus = v_minus->a + v_minus->s +
+				dist_id(v_minus->id, v_plus->id);
 	double a_v_plus = MIN(MAX(a_quote_v_plus, v_plus->e), v_plus->l);
 	p_tw += MAX(0., a_quote_v_plus - v_plus->l);
 	p_tw += MAX(0., a_v_plus - v_plus->z);
@@ -80,9 +89,10 @@ tw_penalty_get_eject_delta_inline(struct customer *v)
 static ALWAYS_INLINE double
 tw_penalty_one_opt_penalty_inline(struct customer *v, struct customer *w)
 {
-	struct customer *w_plus = route_next(w);
-	double p_tw = v->tw_pf + w_plus->tw_sf;
-	double a_quote_w_plus = v->a + v->s + dist(v, w_plus);
+	struct route_tw_data *v_tw = &v->route->tw[v->idx];
+	struct route_tw_data *w_plus = &w->route->tw[w->idx + 1];
+	double p_tw = v_tw->tw_pf + w_plus->tw_sf;
+	double a_quote_w_plus = v_tw->a + v_tw->s + dist_id(v_tw->id, w_plus->id);
 	p_tw += MAX(0., a_quote_w_plus - w_plus->z);
 	return p_tw;
 }
@@ -112,16 +122,23 @@ tw_penalty_exchange_penalty_delta_fast_inline(struct customer *v,
 	       tw_penalty_get_replace_delta_inline(w, v);
 }
 
+static ALWAYS_INLINE double
+c_penalty_get_total_demand_inline(struct route *r)
+{
+	return r->demand_pf[r->size - 1];
+}
+
 static ALWAYS_INLINE double
 c_penalty_get_penalty_inline(struct route *r)
 {
-	return MAX(0., depot_tail(r)->demand_pf - p.vc);
+	return MAX(0., c_penalty_get_total_demand_inline(r) - p.vc);
 }
 
 static ALWAYS_INLINE double
 c_penalty_get_insert_penalty_inline(struct customer *v, struct customer *w)
 {
-	return MAX(0., depot_tail(v->route)->demand_pf + w->demand - p.vc);
+	return MAX(0., c_penalty_get_total_demand_inline(v->route) +
+		       w->demand - p.vc);
 }
 
 static ALWAYS_INLINE double
@@ -134,8 +151,8 @@ c_penalty_get_insert_delta_inline(struct customer *v, struct customer *w)
 static ALWAYS_INLINE double
 c_penalty_get_replace_penalty_inline(struct customer *v, struct customer *w)
 {
-	return MAX(0., depot_tail(v->route)->demand_pf - v->demand + w->demand -
-			   p.vc);
+	return MAX(0., c_penalty_get_total_demand_inline(v->route) -
+		       v->demand + w->demand - p.vc);
 }
 
 static ALWAYS_INLINE double
@@ -148,7 +165,8 @@ c_penalty_get_replace_delta_inline(struct customer *v, struct customer *w)
 static ALWAYS_INLINE double
 c_penalty_get_eject_penalty_inline(struct customer *v)
 {
-	return MAX(0., depot_tail(v->route)->demand_pf - v->demand - p.vc);
+	return MAX(0., c_penalty_get_total_demand_inline(v->route) -
+		       v->demand - p.vc);
 }
 
 static ALWAYS_INLINE double
@@ -161,8 +179,8 @@ c_penalty_get_eject_delta_inline(struct customer *v)
 static ALWAYS_INLINE double
 c_penalty_one_opt_penalty_inline(struct customer *v, struct customer *w)
 {
-	struct customer *w_plus = route_next(w);
-	return MAX(0., v->demand_pf + w_plus->demand_sf - p.vc);
+	return MAX(0., v->route->demand_pf[v->idx] +
+		       w->route->demand_sf[w->idx + 1] - p.vc);
 }
 
 static ALWAYS_INLINE double
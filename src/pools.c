@@ -0,0 +1,50 @@
+#include "pools.h"
+
+#include "core/memory.h"
+#include "small_extra/rlist_persistent.h"
+
+#include "customer.h"
+#include "route.h"
+
+struct pools pools;
+
+static struct slab_cache pools_slab_cache;
+
+void
+pools_init(void)
+{
+	slab_cache_create(&pools_slab_cache, &runtime);
+	mempool_create(&pools.customer, &pools_slab_cache,
+		       sizeof(struct customer));
+	mempool_create(&pools.route, &pools_slab_cache, sizeof(struct route));
+	for (int i = 0; i < ROUTE_DATA_POOL_COUNT; i++) {
+		mempool_create(&pools.route_data[i], &pools_slab_cache,
+			       route_data_size(ROUTE_DATA_MIN_CAPACITY << i));
+	}
+	mempool_create(&pools.rlist_assign_op, &pools_slab_cache,
+		       sizeof(struct rlist_assign_op));
+}
+
+/** The rlist_persistent operations are taken from the pool */
+struct rlist_assign_op *
+rlist_assign_op_alloc(void)
+{
+	return xmempool_alloc(&pools.rlist_assign_op);
+}
+
+void
+rlist_assign_op_free(struct rlist_assign_op *op)
+{
+	mempool_free(&pools.rlist_assign_op, op);
+}
+
+void
+pools_free(void)
+{
+	mempool_destroy(&pools.customer);
+	mempool_destroy(&pools.route);
+	for (int i = 0; i < ROUTE_DATA_POOL_COUNT; i++)
+		mempool_destroy(&pools.route_data[i]);
+	mempool_destroy(&pools.rlist_assign_op);
+	slab_cache_destroy(&pools_slab_cache);
+}
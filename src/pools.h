@@ -0,0 +1,46 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_POOLS_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_POOLS_H
+
+#include "small/mempool.h"
+#include "utils.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Capacity of the smallest route data block, see route_grow() */
+#define ROUTE_DATA_MIN_CAPACITY 8
+
+/**
+ * Number of route data size classes. Class i holds blocks with
+ * capacity ROUTE_DATA_MIN_CAPACITY << i, larger blocks are allocated
+ * with malloc().
+ */
+#define ROUTE_DATA_POOL_COUNT 10
+
+/**
+ * Pools of the objects that the solver allocates on its hot path
+ * (solution_dup(), route_dup() and friends). All of them are built
+ * on the runtime slab arena, so memory_init() must be called first.
+ * mempool_count() gives the number of live objects in a pool.
+ */
+struct pools {
+	struct mempool customer;
+	struct mempool route;
+	struct mempool route_data[ROUTE_DATA_POOL_COUNT];
+	struct mempool rlist_assign_op;
+};
+
+extern struct pools pools;
+
+void
+pools_init(void);
+
+void
+pools_free(void);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_POOLS_H
@@ -1,12 +1,28 @@
 #include "problem.h"
 
 #include <math.h>
+#include <sys/mman.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "dist.h"
+#include "neighbours.h"
+#include "parallel.h"
+
+/** Minimal number of rows worth a thread of problem_init_rows() */
+#define PROBLEM_INIT_ROWS_GRAIN 64
 
 struct problem p;
 
-static double
-customer_distance(struct customer *lhs, struct customer *rhs)
+double
+problem_customer_distance(struct customer *lhs, struct customer *rhs)
 {
+	if (p.explicit_distances)
+		return p.distance_matrix[lhs->id * p.distance_matrix_stride +
+					 rhs->id];
 	double dx = lhs->x - rhs->x;
 	double dy = lhs->y - rhs->y;
 	return sqrt(dx * dx + dy * dy);
@@ -20,6 +36,33 @@ problem_customers_dup(struct rlist *list)
 		rlist_add_tail_entry(list, customer_dup(c), in_route);
 }
 
+int
+problem_distance_matrix_stride(int n)
+{
+	/** Pad rows so that every one of them is cache line aligned */
+	const int per_line = CACHELINE_SIZE / sizeof(distance_t);
+	return DIV_ROUND_UP(n, per_line) * per_line;
+}
+
+void
+problem_free_tables(void)
+{
+	neighbours_free();
+	if (p.cache_map != NULL) {
+		munmap(p.cache_map, p.cache_map_size);
+		p.cache_map = NULL;
+		p.cache_map_size = 0;
+	} else {
+		free(p.distance_matrix);
+		free(p.infeasible_arcs);
+	}
+	p.distance_matrix = NULL;
+	p.distance_matrix_stride = 0;
+	p.infeasible_arcs = NULL;
+	p.infeasible_arcs_stride = 0;
+	p.explicit_distances = false;
+}
+
 void
 problem_destroy(void)
 {
@@ -30,27 +73,172 @@ problem_destroy(void)
 	p.depot = NULL;
 	p.n_customers = 0;
 	rlist_create(&p.customers);
+	problem_free_tables();
 }
 
-void
-problem_init_distance_matrix(void)
+/**
+ * Distances from (x, y) to the points (xs[j], ys[j]), j in [0, n), n a
+ * multiple of 4. The vector code evaluates the same expression as
+ * problem_customer_distance() and sqrt is correctly rounded, so the
+ * results are bit-identical to the scalar ones.
+ */
+static void
+problem_row_distances(double x, double y, const double *xs,
+		      const double *ys, int n, double *out)
 {
-	struct customer *customers[MAX_N_CUSTOMERS + 1] = {0};
-	customers[0] = p.depot;
+	assert(n % 4 == 0);
+	int j = 0;
+#if defined(__AVX__)
+	__m256d vx = _mm256_set1_pd(x);
+	__m256d vy = _mm256_set1_pd(y);
+	for (; j < n; j += 4) {
+		__m256d dx = _mm256_sub_pd(vx, _mm256_loadu_pd(&xs[j]));
+		__m256d dy = _mm256_sub_pd(vy, _mm256_loadu_pd(&ys[j]));
+		__m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx),
+					   _mm256_mul_pd(dy, dy));
+		_mm256_storeu_pd(&out[j], _mm256_sqrt_pd(d2));
+	}
+#elif defined(__SSE2__)
+	__m128d vx = _mm_set1_pd(x);
+	__m128d vy = _mm_set1_pd(y);
+	for (; j < n; j += 2) {
+		__m128d dx = _mm_sub_pd(vx, _mm_loadu_pd(&xs[j]));
+		__m128d dy = _mm_sub_pd(vy, _mm_loadu_pd(&ys[j]));
+		__m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+		_mm_storeu_pd(&out[j], _mm_sqrt_pd(d2));
+	}
+#endif
+	for (; j < n; j++) {
+		double dx = x - xs[j];
+		double dy = y - ys[j];
+		out[j] = sqrt(dx * dx + dy * dy);
+	}
+}
+
+struct problem_init_rows_arg {
+	struct customer **customers;
+	int n;
+	/**
+	 * Coordinates of the customers, zero padded up to the stride.
+	 * NULL if the distances are explicit and the rows are filled.
+	 */
+	double *xs;
+	double *ys;
+};
+
+/**
+ * Fill the rows [begin, end) of the distance matrix and of the
+ * infeasible arcs bitmap. Every row is computed in full, rather than
+ * mirrored from the upper triangle, so the threads never write to
+ * the same cache line. The explicit distances are only padded.
+ */
+static void
+problem_init_rows(int begin, int end, void *arg)
+{
+	struct problem_init_rows_arg *a = arg;
+	struct customer **customers = a->customers;
+	int n = a->n;
+	int stride = p.distance_matrix_stride;
+#if DISTANCE_MATRIX_FLOAT
+	double *distances = xmalloc(sizeof(distances[0]) * stride);
+#endif
+	for (int i = begin; i < end; i++) {
+		distance_t *row = &p.distance_matrix[i * stride];
+		struct customer *c = customers[i];
+		if (a->xs != NULL) {
+#if DISTANCE_MATRIX_FLOAT
+			problem_row_distances(c->x, c->y, a->xs, a->ys, stride,
+					      distances);
+			for (int j = 0; j < n; j++)
+				row[j] = (distance_t)distances[j];
+#else
+			problem_row_distances(c->x, c->y, a->xs, a->ys, stride,
+					      row);
+#endif
+		}
+		/** Keep the padding initialized */
+		for (int j = n; j < stride; j++)
+			row[j] = 0.;
+
+		uint64_t *arcs = &p.infeasible_arcs[i * p.infeasible_arcs_stride];
+		for (int j = 0; j < n; j++) {
+			/** Time warp at j when c is served at its ready time */
+			if (c->e + c->s + (double)row[j] > customers[j]->l)
+				arcs[j / 64] |= (uint64_t)1 << (j % 64);
+		}
+	}
+#if DISTANCE_MATRIX_FLOAT
+	free(distances);
+#endif
+}
 
+distance_t *
+problem_alloc_distance_matrix(void)
+{
+	int n = p.n_customers + 1;
+	problem_free_tables();
+	int stride = problem_distance_matrix_stride(n);
+	p.distance_matrix = xaligned_alloc(sizeof(distance_t) * n * stride,
+					   CACHELINE_SIZE);
+	p.distance_matrix_stride = stride;
+	int arcs_stride = DIV_ROUND_UP(n, 64);
+	p.infeasible_arcs = xcalloc((size_t)n * arcs_stride, sizeof(uint64_t));
+	p.infeasible_arcs_stride = arcs_stride;
+	return p.distance_matrix;
+}
+
+/** The depot and the customers indexed by id */
+static struct customer **
+problem_customers_by_id(void)
+{
+	struct customer **customers = xcalloc(p.n_customers + 1,
+					      sizeof(*customers));
+	customers[0] = p.depot;
 	struct customer *c;
 	rlist_foreach_entry(c, &p.customers, in_route)
 		customers[c->id] = c;
+	return customers;
+}
 
-	for (int i = 0; i <= p.n_customers; i++) {
-		assert(customers[i] != NULL);
-		for (int j = i; j <= p.n_customers; j++) {
-			assert(customers[j] != NULL);
-			double distance = customer_distance(customers[i], customers[j]);
-			p.distance_matrix[i][j] = distance;
-			p.distance_matrix[j][i] = distance;
-		}
+void
+problem_init_distance_matrix(void)
+{
+	int n = p.n_customers + 1;
+	problem_alloc_distance_matrix();
+	int stride = p.distance_matrix_stride;
+	struct problem_init_rows_arg arg = {
+		.customers = problem_customers_by_id(),
+		.n = n,
+		.xs = xcalloc(stride, sizeof(double)),
+		.ys = xcalloc(stride, sizeof(double)),
+	};
+	for (int i = 0; i < n; i++) {
+		assert(arg.customers[i] != NULL);
+		arg.xs[i] = arg.customers[i]->x;
+		arg.ys[i] = arg.customers[i]->y;
 	}
+	parallel_for(n, PROBLEM_INIT_ROWS_GRAIN, problem_init_rows, &arg);
+	free(arg.xs);
+	free(arg.ys);
+	free(arg.customers);
+}
+
+void
+problem_init_explicit_distance_matrix(void)
+{
+	int n = p.n_customers + 1;
+	assert(p.distance_matrix != NULL && p.cache_map == NULL);
+	p.explicit_distances = true;
+	struct problem_init_rows_arg arg = {
+		.customers = problem_customers_by_id(),
+		.n = n,
+		.xs = NULL,
+		.ys = NULL,
+	};
+	for (int i = 0; i < n; i++)
+		assert(arg.customers[i] != NULL);
+	parallel_for(n, PROBLEM_INIT_ROWS_GRAIN, problem_init_rows, &arg);
+	free(arg.customers);
 }
 
 int
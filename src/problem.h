@@ -2,16 +2,59 @@
 #define EAMA_ROUTES_MINIMIZATION_HEURISTIC_PROBLEM_H
 
 #include "customer.h"
+#include <stdbool.h>
+#include <stdint.h>
 #include "small/rlist.h"
 
-#define MAX_N_CUSTOMERS 2000
+#ifndef DISTANCE_MATRIX_FLOAT
+#define DISTANCE_MATRIX_FLOAT 0
+#endif
+
+/**
+ * Element type of the distance matrix, see
+ * cmake/SetDistancePrecision.cmake. dist() always returns double,
+ * so the penalty arithmetic is not affected by this choice.
+ */
+#if DISTANCE_MATRIX_FLOAT
+typedef float distance_t;
+#else
+typedef double distance_t;
+#endif
 
 struct problem {
 	double vc;
 	struct customer *depot;
 	struct rlist customers;
 	int n_customers;
-	double distance_matrix[MAX_N_CUSTOMERS + 1][MAX_N_CUSTOMERS + 1];
+	/**
+	 * Row-major (n_customers + 1) x (n_customers + 1) matrix built by
+	 * problem_init_distance_matrix(). Rows are padded up to
+	 * `distance_matrix_stride` elements, so each of them starts on a
+	 * cache line boundary.
+	 */
+	distance_t *distance_matrix;
+	int distance_matrix_stride;
+	/**
+	 * Bitmap of the arcs (i, j) that can not be part of a feasible
+	 * route, because j can not be reached in time even if i is served
+	 * at its ready time. Row i starts at word i * `infeasible_arcs_stride`.
+	 * Built together with the distance matrix.
+	 */
+	uint64_t *infeasible_arcs;
+	int infeasible_arcs_stride;
+	/**
+	 * Set if the distance matrix is given by the problem file rather
+	 * than computed from the coordinates, see
+	 * problem_init_explicit_distance_matrix().
+	 */
+	bool explicit_distances;
+	/**
+	 * Read-only mapping of the cache file the matrix and the bitmap
+	 * point into, see problem_cache_decode(). NULL if they are
+	 * allocated.
+	 */
+	void *cache_map;
+	size_t cache_map_size;
 };
 
 extern struct problem p;
@@ -26,9 +69,47 @@ problem_customers_dup(struct rlist *list);
 void
 problem_destroy(void);
 
+/** Compute the Euclidean distance matrix and the infeasible arcs */
 void
 problem_init_distance_matrix(void);
 
+/**
+ * Free the tables and allocate the distance matrix of p.n_customers
+ * customers, which the caller fills with the explicit distances, e.g.
+ * straight from the problem file. Returns p.distance_matrix.
+ */
+distance_t *
+problem_alloc_distance_matrix(void);
+
+/**
+ * Finish the matrix filled after problem_alloc_distance_matrix(): pad
+ * its rows and build the infeasible arcs. The customers must be set.
+ */
+void
+problem_init_explicit_distance_matrix(void);
+
+/**
+ * Row stride of the distance matrix of n points (the depot included),
+ * see problem::distance_matrix.
+ */
+int
+problem_distance_matrix_stride(int n);
+
+/**
+ * Free the distance matrix, the infeasible arcs bitmap and the
+ * neighbour lists, or unmap them if they come from a cache file.
+ */
+void
+problem_free_tables(void);
+
+/**
+ * Euclidean distance computed from coordinates in full precision,
+ * regardless of the distance matrix element type. The explicit
+ * distances come from the matrix.
+ */
+double
+problem_customer_distance(struct customer *lhs, struct customer *rhs);
+
 int
 problem_routes_straight_lower_bound(void);
 
@@ -0,0 +1,263 @@
+#include "problem_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "neighbours.h"
+#include "problem_decode.h"
+
+#include "core/say.h"
+
+#define PROBLEM_CACHE_MAGIC "VRPTWBIN"
+
+struct problem_cache_header {
+	char magic[8];
+	uint32_t version;
+	/** sizeof(distance_t) of the writer */
+	uint32_t distance_size;
+	uint64_t source_hash;
+	/** Size of the whole file */
+	uint64_t size;
+	double vc;
+	int32_t n_customers;
+	int32_t distance_matrix_stride;
+	int32_t infeasible_arcs_stride;
+	int32_t neighbours_k;
+	int32_t neighbours_tw;
+	/** See problem::explicit_distances */
+	int32_t explicit_distances;
+	/** The sections, each one is cache line aligned */
+	uint64_t customers_offset;
+	uint64_t distance_matrix_offset;
+	uint64_t infeasible_arcs_offset;
+	uint64_t neighbours_offset;
+};
+
+/** The depot goes first, then the customers in the problem order */
+struct problem_cache_customer {
+	int32_t id;
+	int32_t unused;
+	double x;
+	double y;
+	double demand;
+	double e;
+	double l;
+	double s;
+};
+
+static inline uint64_t
+problem_cache_align(uint64_t offset)
+{
+	return DIV_ROUND_UP(offset, CACHELINE_SIZE) * CACHELINE_SIZE;
+}
+
+/** Fill the header fields that only depend on n_customers and k */
+static void
+problem_cache_layout(struct problem_cache_header *h, int n_customers,
+		     int k)
+{
+	int n = n_customers + 1;
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, PROBLEM_CACHE_MAGIC, sizeof(h->magic));
+	h->version = PROBLEM_CACHE_VERSION;
+	h->distance_size = sizeof(distance_t);
+	h->n_customers = n_customers;
+	h->distance_matrix_stride = problem_distance_matrix_stride(n);
+	h->infeasible_arcs_stride = DIV_ROUND_UP(n, 64);
+	h->neighbours_k = k;
+	h->customers_offset = problem_cache_align(sizeof(*h));
+	h->distance_matrix_offset = problem_cache_align(h->customers_offset +
+		sizeof(struct problem_cache_customer) * n);
+	h->infeasible_arcs_offset = problem_cache_align(
+		h->distance_matrix_offset +
+		sizeof(distance_t) * n * h->distance_matrix_stride);
+	h->neighbours_offset = problem_cache_align(h->infeasible_arcs_offset +
+		sizeof(uint64_t) * n * h->infeasible_arcs_stride);
+	h->size = h->neighbours_offset + sizeof(int) * n * k;
+}
+
+uint64_t
+problem_cache_hash_file(const char *file)
+{
+	FILE *f = fopen(file, "rb");
+	if (f == NULL)
+		panic("problem_cache: cannot open file '%s': %s", file,
+		      strerror(errno));
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	unsigned char buf[1 << 16];
+	size_t size;
+	while ((size = fread(buf, 1, sizeof(buf), f)) > 0) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= buf[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	if (ferror(f))
+		panic("problem_cache: cannot read file '%s'", file);
+	fclose(f);
+	return hash;
+}
+
+static void
+problem_cache_customer_set(struct problem_cache_customer *cc,
+			   struct customer *c)
+{
+	cc->id = c->id;
+	cc->x = c->x;
+	cc->y = c->y;
+	cc->demand = c->demand;
+	cc->e = c->e;
+	cc->l = c->l;
+	cc->s = c->s;
+}
+
+void
+problem_cache_save(const char *path, uint64_t hash, bool tw)
+{
+	struct problem_cache_header h;
+	problem_cache_layout(&h, p.n_customers, neighbours_k());
+	h.source_hash = hash;
+	h.vc = p.vc;
+	h.neighbours_tw = tw;
+	h.explicit_distances = p.explicit_distances;
+	assert(neighbours_ready(h.neighbours_k, tw));
+	assert(p.distance_matrix_stride == h.distance_matrix_stride);
+	assert(p.infeasible_arcs_stride == h.infeasible_arcs_stride);
+
+	int n = p.n_customers + 1;
+	char *image = xcalloc(1, h.size);
+	memcpy(image, &h, sizeof(h));
+	struct problem_cache_customer *cs =
+		(void *)(image + h.customers_offset);
+	problem_cache_customer_set(&cs[0], p.depot);
+	struct customer *c;
+	int i = 1;
+	rlist_foreach_entry(c, &p.customers, in_route)
+		problem_cache_customer_set(&cs[i++], c);
+	memcpy(image + h.distance_matrix_offset, p.distance_matrix,
+	       sizeof(distance_t) * n * h.distance_matrix_stride);
+	memcpy(image + h.infeasible_arcs_offset, p.infeasible_arcs,
+	       sizeof(uint64_t) * n * h.infeasible_arcs_stride);
+	memcpy(image + h.neighbours_offset, neighbours_row(0),
+	       sizeof(int) * n * h.neighbours_k);
+
+	/** Write a temporary file first, the readers never see a torn one */
+	char tmp_path[PATH_MAX];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+	FILE *f = fopen(tmp_path, "wb");
+	if (f == NULL)
+		panic("problem_cache: cannot create file '%s': %s", tmp_path,
+		      strerror(errno));
+	if (fwrite(image, 1, h.size, f) != h.size || fclose(f) != 0)
+		panic("problem_cache: cannot write file '%s': %s", tmp_path,
+		      strerror(errno));
+	if (rename(tmp_path, path) != 0)
+		panic("problem_cache: cannot rename '%s' to '%s': %s",
+		      tmp_path, path, strerror(errno));
+	free(image);
+}
+
+static bool
+problem_cache_header_valid(const struct problem_cache_header *h,
+			   uint64_t size, uint64_t hash, int n_near, bool tw)
+{
+	if (size < sizeof(*h) ||
+	    memcmp(h->magic, PROBLEM_CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != PROBLEM_CACHE_VERSION ||
+	    h->distance_size != sizeof(distance_t) ||
+	    h->source_hash != hash)
+		return false;
+	if (h->n_customers < 1 ||
+	    h->neighbours_k < 1 || h->neighbours_k > h->n_customers ||
+	    h->neighbours_tw != tw ||
+	    h->neighbours_k < MIN(n_near, h->n_customers))
+		return false;
+	/** The layout is derived from the sizes, the rest must match it */
+	struct problem_cache_header expected;
+	problem_cache_layout(&expected, h->n_customers, h->neighbours_k);
+	return h->size == size &&
+	       h->distance_matrix_stride == expected.distance_matrix_stride &&
+	       h->infeasible_arcs_stride == expected.infeasible_arcs_stride &&
+	       h->customers_offset == expected.customers_offset &&
+	       h->distance_matrix_offset == expected.distance_matrix_offset &&
+	       h->infeasible_arcs_offset == expected.infeasible_arcs_offset &&
+	       h->neighbours_offset == expected.neighbours_offset &&
+	       h->size == expected.size;
+}
+
+static struct customer *
+problem_cache_customer_new(const struct problem_cache_customer *cc)
+{
+	struct customer c;
+	memset(&c, 0, sizeof(c));
+	c.id = cc->id;
+	c.x = cc->x;
+	c.y = cc->y;
+	c.demand = cc->demand;
+	c.e = cc->e;
+	c.l = cc->l;
+	c.s = cc->s;
+	return customer_dup(&c);
+}
+
+bool
+problem_cache_load(const char *path, uint64_t hash, int n_near, bool tw)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+	    (uint64_t)st.st_size < sizeof(struct problem_cache_header)) {
+		close(fd);
+		return false;
+	}
+	size_t size = st.st_size;
+	char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+	const struct problem_cache_header *h = (const void *)map;
+	if (!problem_cache_header_valid(h, size, hash, n_near, tw)) {
+		munmap(map, size);
+		return false;
+	}
+
+	problem_free_tables();
+	const struct problem_cache_customer *cs =
+		(const void *)(map + h->customers_offset);
+	p.vc = h->vc;
+	p.n_customers = h->n_customers;
+	p.depot = problem_cache_customer_new(&cs[0]);
+	rlist_create(&p.customers);
+	for (int i = 1; i <= h->n_customers; i++)
+		rlist_add_tail_entry(&p.customers,
+				     problem_cache_customer_new(&cs[i]),
+				     in_route);
+	p.cache_map = map;
+	p.cache_map_size = size;
+	p.distance_matrix = (distance_t *)(map + h->distance_matrix_offset);
+	p.distance_matrix_stride = h->distance_matrix_stride;
+	p.infeasible_arcs = (uint64_t *)(map + h->infeasible_arcs_offset);
+	p.infeasible_arcs_stride = h->infeasible_arcs_stride;
+	p.explicit_distances = h->explicit_distances != 0;
+	neighbours_attach((const int *)(map + h->neighbours_offset),
+			  h->neighbours_k, tw);
+	return true;
+}
+
+void
+problem_cache_decode(const char *file, const char *dir, int n_near, bool tw)
+{
+	uint64_t hash = problem_cache_hash_file(file);
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%016" PRIx64 ".bin", dir, hash);
+	if (problem_cache_load(path, hash, n_near, tw))
+		return;
+	problem_decode(file);
+	neighbours_init(n_near, tw);
+	problem_cache_save(path, hash, tw);
+}
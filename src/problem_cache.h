@@ -0,0 +1,55 @@
+#ifndef EAMA_ROUTES_MINIMIZATION_HEURISTIC_PROBLEM_CACHE_H
+#define EAMA_ROUTES_MINIMIZATION_HEURISTIC_PROBLEM_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "problem.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Version of the cache file format. Bump it on any change of the
+ * layout, the old files are rebuilt then.
+ */
+#define PROBLEM_CACHE_VERSION 2
+
+/** FNV-1a hash of the contents of \a file, the key of its cache */
+uint64_t
+problem_cache_hash_file(const char *file);
+
+/**
+ * Write the current problem to \a path: the customers, the distance
+ * matrix, the infeasible arcs and the neighbour lists, which must be
+ * built with neighbours_init(k, tw).
+ */
+void
+problem_cache_save(const char *path, uint64_t hash, bool tw);
+
+/**
+ * Map the cache file \a path and set up the problem from it. The
+ * matrix, the bitmap and the neighbour lists stay in the read-only
+ * mapping, so the processes solving the same instance share their
+ * pages. Returns false and leaves the problem intact if the file is
+ * missing, has another version, another hash or distance precision,
+ * or its neighbour lists do not fit neighbours_ready(n_near, tw).
+ */
+bool
+problem_cache_load(const char *path, uint64_t hash, int n_near, bool tw);
+
+/**
+ * problem_decode() \a file through the cache in the directory \a dir:
+ * load the cache of the file if it is valid, otherwise decode the
+ * file, build the neighbour lists for \a n_near and \a tw and write
+ * the cache for the next runs.
+ */
+void
+problem_cache_decode(const char *file, const char *dir, int n_near, bool tw);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif //EAMA_ROUTES_MINIMIZATION_HEURISTIC_PROBLEM_CACHE_H
@@ -1,56 +1,609 @@
 #include "problem_decode.h"
 
-#include <fstream>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
 
-void
-problem_decode(const char *file)
+#include "core/say.h"
+
+/**
+ * Tokenizer over the mapped problem file. Tokens are the runs of
+ * non-whitespace characters, they are never copied.
+ */
+struct problem_lexer {
+	const char *file;
+	const char *pos;
+	const char *end;
+	/** Line of pos, starting from 1 */
+	int line;
+	/** Line of the last token */
+	int token_line;
+};
+
+struct problem_token {
+	const char *str;
+	int len;
+	int line;
+};
+
+static inline bool
+problem_lexer_is_space(char c)
 {
-	p.n_customers = 0;
-	std::string file_string = std::string(file);
-	std::ifstream f(file_string);
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+	       c == '\v' || c == '\f';
+}
+
+/** Returns false at the end of the file */
+static bool
+problem_lexer_next(struct problem_lexer *l, struct problem_token *t)
+{
+	while (l->pos < l->end && problem_lexer_is_space(*l->pos)) {
+		if (*l->pos == '\n')
+			l->line++;
+		l->pos++;
+	}
+	if (l->pos == l->end)
+		return false;
+	t->str = l->pos;
+	t->line = l->token_line = l->line;
+	while (l->pos < l->end && !problem_lexer_is_space(*l->pos))
+		l->pos++;
+	t->len = (int)(l->pos - t->str);
+	return true;
+}
+
+/**
+ * Read the rest of the line of the next token, trailing whitespace
+ * trimmed. Returns false at the end of the file.
+ */
+static bool
+problem_lexer_next_line(struct problem_lexer *l, struct problem_token *t)
+{
+	if (!problem_lexer_next(l, t))
+		return false;
+	while (l->pos < l->end && *l->pos != '\n')
+		l->pos++;
+	const char *end = l->pos;
+	while (end > t->str && problem_lexer_is_space(end[-1]))
+		end--;
+	t->len = (int)(end - t->str);
+	return true;
+}
+
+static inline bool
+problem_token_equals(const struct problem_token *t, const char *word)
+{
+	return t->len == (int)strlen(word) && memcmp(t->str, word, t->len) == 0;
+}
+
+static void
+problem_lexer_expect(struct problem_lexer *l, struct problem_token *t,
+		     const char *what)
+{
+	if (!problem_lexer_next(l, t))
+		panic("problem_decode: %s:%d: expected %s, got the end of "
+		      "the file", l->file, l->token_line, what);
+}
+
+static void
+problem_lexer_expect_word(struct problem_lexer *l, const char *word)
+{
+	struct problem_token t;
+	problem_lexer_expect(l, &t, word);
+	if (!problem_token_equals(&t, word))
+		panic("problem_decode: %s:%d: expected '%s', got '%.*s'",
+		      l->file, t.line, word, t.len, t.str);
+}
+
+/** Powers of 10 that are exact in double */
+static const double problem_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * Parse a decimal number like strtod() does. The plain decimals with
+ * at most 15 significant digits are the quotient of two exact doubles,
+ * which is correctly rounded, so they are parsed inline. The rest,
+ * e.g. the numbers with an exponent, go to strtod().
+ */
+static bool
+problem_token_to_double(const struct problem_token *t, double *value)
+{
+	const char *s = t->str, *end = t->str + t->len;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+	int64_t mantissa = 0;
+	int n_digits = 0, n_fraction = 0;
+	bool fraction = false;
+	for (; s < end; s++) {
+		if (*s >= '0' && *s <= '9') {
+			mantissa = mantissa * 10 + (*s - '0');
+			n_digits++;
+			n_fraction += fraction;
+			if (n_digits > 15)
+				break;
+		} else if (*s == '.' && !fraction) {
+			fraction = true;
+		} else {
+			break;
+		}
+	}
+	if (s == end && n_digits > 0) {
+		double v = (double)mantissa / problem_pow10[n_fraction];
+		*value = negative ? -v : v;
+		return true;
+	}
+	char buf[64];
+	if (t->len >= (int)sizeof(buf))
+		return false;
+	memcpy(buf, t->str, t->len);
+	buf[t->len] = '\0';
+	char *parsed_end;
+	errno = 0;
+	*value = strtod(buf, &parsed_end);
+	return parsed_end == buf + t->len && errno == 0 &&
+	       std::isfinite(*value);
+}
+
+static bool
+problem_token_to_int(const struct problem_token *t, int *value)
+{
+	const char *s = t->str, *end = t->str + t->len;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+	if (s == end)
+		return false;
+	int64_t v = 0;
+	for (; s < end; s++) {
+		if (*s < '0' || *s > '9' || v > INT32_MAX)
+			return false;
+		v = v * 10 + (*s - '0');
+	}
+	v = negative ? -v : v;
+	if (v < INT32_MIN || v > INT32_MAX)
+		return false;
+	*value = (int)v;
+	return true;
+}
+
+static double
+problem_lexer_double(struct problem_lexer *l, const char *what)
+{
+	struct problem_token t;
+	double value;
+	problem_lexer_expect(l, &t, what);
+	if (!problem_token_to_double(&t, &value))
+		panic("problem_decode: %s:%d: expected %s, got '%.*s'",
+		      l->file, t.line, what, t.len, t.str);
+	return value;
+}
+
+static int
+problem_lexer_int(struct problem_lexer *l, const char *what)
+{
+	struct problem_token t;
+	int value;
+	problem_lexer_expect(l, &t, what);
+	if (!problem_token_to_int(&t, &value))
+		panic("problem_decode: %s:%d: expected %s, got '%.*s'",
+		      l->file, t.line, what, t.len, t.str);
+	return value;
+}
+
+/** Parse the fields of the customer after its id */
+static void
+problem_lexer_customer(struct problem_lexer *l, struct customer *c)
+{
+	c->x = problem_lexer_double(l, "XCOORD.");
+	c->y = problem_lexer_double(l, "YCOORD.");
+	c->demand = problem_lexer_double(l, "DEMAND");
+	c->e = problem_lexer_double(l, "READY TIME");
+	c->l = problem_lexer_double(l, "DUE DATE");
+	c->s = problem_lexer_double(l, "SERVICE TIME");
+}
+
+/** The Solomon format, see the instances of the benchmark sets */
+static void
+problem_decode_solomon(struct problem_lexer *l)
+{
+	const char *file = l->file;
 	//c1_2_1
 	//
-	std::string test_name;
-	f >> test_name;
+	struct problem_token t;
+	problem_lexer_expect(l, &t, "the instance name");
 	//VEHICLE
 	//NUMBER     CAPACITY
-	std::string vehicle_header[] = {
+	const char *vehicle_header[] = {
 		"VEHICLE", "NUMBER", "CAPACITY"
 	};
-	std::string word;
-	for (const auto& expected : vehicle_header) {
-		f >> word;
-		assert(expected == word);
-	}
+	for (const char *word : vehicle_header)
+		problem_lexer_expect_word(l, word);
 	//  50          200
-	int n_vehicles;
-	f >> n_vehicles;
-	f >> p.vc;
+	int n_vehicles = problem_lexer_int(l, "NUMBER");
+	(void)n_vehicles;
+	p.vc = problem_lexer_double(l, "CAPACITY");
 	//CUSTOMER
 	//CUST NO.  XCOORD.    YCOORD.    DEMAND   READY TIME  DUE DATE   SERVICE TIME
-	std::string customer_header[] = {
+	const char *customer_header[] = {
 		"CUSTOMER", "CUST", "NO.", "XCOORD.",
 		"YCOORD.", "DEMAND", "READY", "TIME",
 		"DUE", "DATE", "SERVICE", "TIME",
 	};
-	for (const auto& expected : customer_header) {
-		f >> word;
-		assert(expected == word);
-	}
-#define read_customer() do {					\
-	f >> c.x >> c.y >> c.demand >> c.e >> c.l >> c.s;	\
-} while(0)
+	for (const char *word : customer_header)
+		problem_lexer_expect_word(l, word);
+
 	customer c{};
-	f >> c.id;
-	assert(c.id == 0);
-	read_customer();
+	c.id = problem_lexer_int(l, "CUST NO.");
+	if (c.id != 0)
+		panic("problem_decode: %s:%d: the depot must have number 0, "
+		      "got %d", file, l->token_line, c.id);
+	problem_lexer_customer(l, &c);
+	p.n_customers = 0;
 	p.depot = customer_dup(&c);
 	rlist_create(&p.customers);
-	while (f >> c.id) {
-		read_customer();
+	while (problem_lexer_next(l, &t)) {
+		if (!problem_token_to_int(&t, &c.id))
+			panic("problem_decode: %s:%d: expected CUST NO., "
+			      "got '%.*s'", file, t.line, t.len, t.str);
+		if (c.id != p.n_customers + 1)
+			panic("problem_decode: %s:%d: expected customer %d, "
+			      "got %d", file, t.line, p.n_customers + 1, c.id);
+		problem_lexer_customer(l, &c);
 		rlist_add_tail_entry(&p.customers, customer_dup(&c), in_route);
 		++p.n_customers;
 	}
+	if (p.n_customers == 0)
+		panic("problem_decode: %s: no customers", file);
 	problem_init_distance_matrix();
-#undef read_customer
+}
+
+/**
+ * Due date of the nodes of a VRPLIB problem without time windows. It
+ * is finite, so the time warp arithmetic stays exact.
+ */
+#define PROBLEM_DECODE_VRPLIB_HORIZON 1e9
+
+enum problem_vrplib_weight_format {
+	PROBLEM_VRPLIB_FULL_MATRIX,
+	PROBLEM_VRPLIB_LOWER_ROW,
+	PROBLEM_VRPLIB_UPPER_ROW,
+	PROBLEM_VRPLIB_LOWER_DIAG_ROW,
+	PROBLEM_VRPLIB_UPPER_DIAG_ROW,
+};
+
+static const char *problem_vrplib_weight_formats[] = {
+	"FULL_MATRIX", "LOWER_ROW", "UPPER_ROW", "LOWER_DIAG_ROW",
+	"UPPER_DIAG_ROW",
+};
+
+struct problem_vrplib {
+	/** Number of the nodes, the depot included */
+	int dimension;
+	bool explicit_distances;
+	enum problem_vrplib_weight_format weight_format;
+	/** Service time of the nodes without SERVICE_TIME_SECTION entry */
+	double service_time;
+	/** Node k of the file, counting from 1, is nodes[k - 1] */
+	struct customer *nodes;
+	/** Set for the nodes with a SERVICE_TIME_SECTION entry */
+	bool *service_time_read;
+	/** Number of the depot node */
+	int depot;
+	/** Set if the EDGE_WEIGHT_SECTION is read */
+	bool edge_weights;
+};
+
+/** The node number starting a line of a section, as an index */
+static int
+problem_lexer_vrplib_node(struct problem_lexer *l,
+			  const struct problem_vrplib *v)
+{
+	int k = problem_lexer_int(l, "node number");
+	if (k < 1 || k > v->dimension)
+		panic("problem_decode: %s:%d: node %d is out of [1, %d]",
+		      l->file, l->token_line, k, v->dimension);
+	return k - 1;
+}
+
+/** Returns true if the next token is a number, consumes nothing */
+static bool
+problem_lexer_peek_number(struct problem_lexer *l)
+{
+	struct problem_lexer saved = *l;
+	struct problem_token t;
+	double value;
+	bool number = problem_lexer_next(l, &t) &&
+		      problem_token_to_double(&t, &value);
+	*l = saved;
+	return number;
+}
+
+/**
+ * Read the EDGE_WEIGHT_SECTION right into the distance matrix in the
+ * file node order, the depot is moved to row 0 afterwards.
+ */
+static void
+problem_decode_vrplib_weights(struct problem_lexer *l,
+			      struct problem_vrplib *v)
+{
+	int n = v->dimension;
+	distance_t *matrix = problem_alloc_distance_matrix();
+	int stride = p.distance_matrix_stride;
+	for (int i = 0; i < n; i++) {
+		int begin = 0, end = n;
+		switch (v->weight_format) {
+		case PROBLEM_VRPLIB_FULL_MATRIX:
+			break;
+		case PROBLEM_VRPLIB_LOWER_ROW:
+			end = i;
+			break;
+		case PROBLEM_VRPLIB_UPPER_ROW:
+			begin = i + 1;
+			break;
+		case PROBLEM_VRPLIB_LOWER_DIAG_ROW:
+			end = i + 1;
+			break;
+		case PROBLEM_VRPLIB_UPPER_DIAG_ROW:
+			begin = i;
+			break;
+		}
+		matrix[i * stride + i] = 0.;
+		for (int j = begin; j < end; j++) {
+			distance_t d = problem_lexer_double(l, "EDGE_WEIGHT");
+			matrix[i * stride + j] = d;
+			if (v->weight_format != PROBLEM_VRPLIB_FULL_MATRIX)
+				matrix[j * stride + i] = d;
+		}
+	}
+}
+
+/** Read a section of the nodes, one line per node */
+static void
+problem_decode_vrplib_nodes(struct problem_lexer *l, struct problem_vrplib *v,
+			    const struct problem_token *section)
+{
+	for (int i = 0; i < v->dimension; i++) {
+		struct customer *c = &v->nodes[problem_lexer_vrplib_node(l, v)];
+		if (problem_token_equals(section, "NODE_COORD_SECTION")) {
+			c->x = problem_lexer_double(l, "X");
+			c->y = problem_lexer_double(l, "Y");
+		} else if (problem_token_equals(section, "DEMAND_SECTION")) {
+			c->demand = problem_lexer_double(l, "DEMAND");
+		} else if (problem_token_equals(section,
+						"TIME_WINDOW_SECTION")) {
+			c->e = problem_lexer_double(l, "READY TIME");
+			c->l = problem_lexer_double(l, "DUE DATE");
+		} else {
+			assert(problem_token_equals(section,
+						    "SERVICE_TIME_SECTION"));
+			c->s = problem_lexer_double(l, "SERVICE TIME");
+			v->service_time_read[c - v->nodes] = true;
+		}
+	}
+}
+
+/** Parse the value of the specification entry \a key */
+static void
+problem_decode_vrplib_spec(struct problem_lexer *l, struct problem_vrplib *v,
+			   const struct problem_token *key,
+			   const struct problem_token *value)
+{
+	const char *file = l->file;
+	if (problem_token_equals(key, "DIMENSION")) {
+		if (!problem_token_to_int(value, &v->dimension) ||
+		    v->dimension < 2)
+			panic("problem_decode: %s:%d: DIMENSION must be at "
+			      "least 2, got '%.*s'", file, value->line,
+			      value->len, value->str);
+	} else if (problem_token_equals(key, "CAPACITY")) {
+		if (!problem_token_to_double(value, &p.vc))
+			panic("problem_decode: %s:%d: expected CAPACITY, "
+			      "got '%.*s'", file, value->line, value->len,
+			      value->str);
+	} else if (problem_token_equals(key, "SERVICE_TIME")) {
+		if (!problem_token_to_double(value, &v->service_time))
+			panic("problem_decode: %s:%d: expected SERVICE_TIME, "
+			      "got '%.*s'", file, value->line, value->len,
+			      value->str);
+	} else if (problem_token_equals(key, "TYPE")) {
+		if (!problem_token_equals(value, "CVRP") &&
+		    !problem_token_equals(value, "VRPTW") &&
+		    !problem_token_equals(value, "CVRPTW"))
+			panic("problem_decode: %s:%d: unsupported TYPE '%.*s'",
+			      file, value->line, value->len, value->str);
+	} else if (problem_token_equals(key, "EDGE_WEIGHT_TYPE")) {
+		/**
+		 * EUC_2D distances are not rounded to integers, like the
+		 * Solomon ones.
+		 */
+		if (problem_token_equals(value, "EXPLICIT"))
+			v->explicit_distances = true;
+		else if (problem_token_equals(value, "EUC_2D") ||
+			 problem_token_equals(value, "EXACT_2D"))
+			v->explicit_distances = false;
+		else
+			panic("problem_decode: %s:%d: unsupported "
+			      "EDGE_WEIGHT_TYPE '%.*s'", file, value->line,
+			      value->len, value->str);
+	} else if (problem_token_equals(key, "EDGE_WEIGHT_FORMAT")) {
+		int n_formats = (int)lengthof(problem_vrplib_weight_formats);
+		int i = 0;
+		while (i < n_formats &&
+		       !problem_token_equals(value,
+					     problem_vrplib_weight_formats[i]))
+			i++;
+		if (i == n_formats)
+			panic("problem_decode: %s:%d: unsupported "
+			      "EDGE_WEIGHT_FORMAT '%.*s'", file, value->line,
+			      value->len, value->str);
+		v->weight_format = (enum problem_vrplib_weight_format)i;
+	}
+	/** NAME, COMMENT, VEHICLES and the rest do not matter */
+}
+
+/** Swap the nodes a and b, their rows and columns of the matrix */
+static void
+problem_decode_vrplib_swap(struct problem_vrplib *v, int a, int b)
+{
+	std::swap(v->nodes[a], v->nodes[b]);
+	std::swap(v->service_time_read[a], v->service_time_read[b]);
+	if (!v->explicit_distances)
+		return;
+	int stride = p.distance_matrix_stride;
+	distance_t *m = p.distance_matrix;
+	for (int j = 0; j < v->dimension; j++)
+		std::swap(m[a * stride + j], m[b * stride + j]);
+	for (int i = 0; i < v->dimension; i++)
+		std::swap(m[i * stride + a], m[i * stride + b]);
+}
+
+/**
+ * The VRPLIB format: the "KEY : VALUE" specification lines followed by
+ * the data sections, see http://vrp.galgos.inf.puc-rio.br/index.php/en/.
+ * The depot gets id 0 and node 1 takes the place of the depot, the
+ * other nodes keep the file order. The nodes without a
+ * SERVICE_TIME_SECTION entry get the SERVICE_TIME, the depot gets 0.
+ */
+static void
+problem_decode_vrplib(struct problem_lexer *l)
+{
+	const char *file = l->file;
+	struct problem_vrplib v = {};
+	v.weight_format = PROBLEM_VRPLIB_FULL_MATRIX;
+	v.depot = 1;
+	p.vc = 0.;
+	struct problem_token t;
+	while (problem_lexer_next_line(l, &t) &&
+	       !problem_token_equals(&t, "EOF")) {
+		const char *colon = (const char *)memchr(t.str, ':', t.len);
+		if (colon != NULL) {
+			if (v.nodes != NULL)
+				panic("problem_decode: %s:%d: specification "
+				      "after the data sections", file, t.line);
+			struct problem_token key = t, value = t;
+			key.len = (int)(colon - t.str);
+			while (key.len > 0 &&
+			       problem_lexer_is_space(key.str[key.len - 1]))
+				key.len--;
+			value.str = colon + 1;
+			value.len = (int)(t.str + t.len - value.str);
+			while (value.len > 0 &&
+			       problem_lexer_is_space(*value.str)) {
+				value.str++;
+				value.len--;
+			}
+			problem_decode_vrplib_spec(l, &v, &key, &value);
+			continue;
+		}
+		if (v.nodes == NULL) {
+			if (v.dimension == 0)
+				panic("problem_decode: %s:%d: '%.*s' before "
+				      "DIMENSION", file, t.line, t.len, t.str);
+			p.n_customers = v.dimension - 1;
+			v.nodes = (struct customer *)
+				xcalloc(v.dimension, sizeof(v.nodes[0]));
+			v.service_time_read = (bool *)
+				xcalloc(v.dimension,
+					sizeof(v.service_time_read[0]));
+			for (int i = 0; i < v.dimension; i++)
+				v.nodes[i].l = PROBLEM_DECODE_VRPLIB_HORIZON;
+		}
+		if (problem_token_equals(&t, "NODE_COORD_SECTION") ||
+		    problem_token_equals(&t, "DEMAND_SECTION") ||
+		    problem_token_equals(&t, "TIME_WINDOW_SECTION") ||
+		    problem_token_equals(&t, "SERVICE_TIME_SECTION")) {
+			problem_decode_vrplib_nodes(l, &v, &t);
+		} else if (problem_token_equals(&t, "DEPOT_SECTION")) {
+			v.depot = problem_lexer_vrplib_node(l, &v) + 1;
+			if (problem_lexer_int(l, "-1") != -1)
+				panic("problem_decode: %s:%d: more than one "
+				      "depot", file, l->token_line);
+		} else if (problem_token_equals(&t, "EDGE_WEIGHT_SECTION")) {
+			if (!v.explicit_distances)
+				panic("problem_decode: %s:%d: "
+				      "EDGE_WEIGHT_SECTION needs "
+				      "EDGE_WEIGHT_TYPE : EXPLICIT", file,
+				      t.line);
+			v.edge_weights = true;
+			problem_decode_vrplib_weights(l, &v);
+		} else {
+			/** E.g. DISPLAY_DATA_SECTION, skip its numbers */
+			struct problem_token skipped;
+			while (problem_lexer_peek_number(l))
+				problem_lexer_next(l, &skipped);
+		}
+	}
+	if (v.nodes == NULL)
+		panic("problem_decode: %s: no data sections", file);
+	if (v.explicit_distances && !v.edge_weights)
+		panic("problem_decode: %s: no EDGE_WEIGHT_SECTION", file);
+
+	if (v.depot != 1)
+		problem_decode_vrplib_swap(&v, 0, v.depot - 1);
+	/** The depot is known only now to default its service time */
+	for (int i = 0; i < v.dimension; i++) {
+		v.nodes[i].id = i;
+		if (!v.service_time_read[i])
+			v.nodes[i].s = i == 0 ? 0. : v.service_time;
+	}
+	p.depot = customer_dup(&v.nodes[0]);
+	rlist_create(&p.customers);
+	for (int i = 1; i < v.dimension; i++)
+		rlist_add_tail_entry(&p.customers, customer_dup(&v.nodes[i]),
+				     in_route);
+	free(v.service_time_read);
+	free(v.nodes);
+	if (v.explicit_distances)
+		problem_init_explicit_distance_matrix();
+	else
+		problem_init_distance_matrix();
+}
+
+/** The files with a ':' in the first line are VRPLIB ones */
+static bool
+problem_is_vrplib(const char *data, size_t size)
+{
+	const char *eol = (const char *)memchr(data, '\n', size);
+	size_t len = eol != NULL ? (size_t)(eol - data) : size;
+	return memchr(data, ':', len) != NULL;
+}
+
+void
+problem_decode(const char *file)
+{
+	int fd = open(file, O_RDONLY);
+	if (fd < 0)
+		panic("problem_decode: cannot open file '%s': %s", file,
+		      strerror(errno));
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		panic("problem_decode: cannot stat file '%s': %s", file,
+		      strerror(errno));
+	if (st.st_size == 0)
+		panic("problem_decode: file '%s' is empty", file);
+	size_t size = st.st_size;
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		panic("problem_decode: cannot map file '%s': %s", file,
+		      strerror(errno));
+	struct problem_lexer l;
+	l.file = file;
+	l.pos = (const char *)map;
+	l.end = l.pos + size;
+	l.line = l.token_line = 1;
+	if (problem_is_vrplib(l.pos, size))
+		problem_decode_vrplib(&l);
+	else
+		problem_decode_solomon(&l);
+	munmap(map, size);
 }
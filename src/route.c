@@ -1,20 +1,107 @@
 #include "route.h"
 
+#include "penalty_inline.h"
+#include "pools.h"
+
+#include "core/fiber.h"
+#include "core/say.h"
+
 #include <string.h>
 
 struct route *
 route_new(void)
 {
-	/* TODO: use mempool to allocate routes */
-	struct route *r = xmalloc(sizeof(struct route));
+	struct route *r = xmempool_alloc(&pools.route);
 	r->size = 0;
+	r->capacity = 0;
+	r->customers = NULL;
+	r->journal = NULL;
+	r->journal_depth = 0;
+	r->tw = NULL;
+	r->demand = r->demand_pf = r->demand_sf = NULL;
 	rlist_create(&r->in_routes);
 	return r;
 }
 
+size_t
+route_data_size(int capacity)
+{
+	return (sizeof(struct route_tw_data) + 3 * sizeof(double) +
+		sizeof(struct customer *)) * capacity;
+}
+
+/** Size class of a data block, see ROUTE_DATA_POOL_COUNT */
+static inline int
+route_data_class(int capacity)
+{
+	assert(capacity >= ROUTE_DATA_MIN_CAPACITY);
+	assert((capacity & (capacity - 1)) == 0);
+	return __builtin_ctz(capacity / ROUTE_DATA_MIN_CAPACITY);
+}
+
+static void *
+route_data_alloc(int capacity)
+{
+	int i = route_data_class(capacity);
+	if (likely(i < ROUTE_DATA_POOL_COUNT))
+		return xmempool_alloc(&pools.route_data[i]);
+	return xmalloc(route_data_size(capacity));
+}
+
+static void
+route_data_free(void *data, int capacity)
+{
+	if (data == NULL)
+		return;
+	int i = route_data_class(capacity);
+	if (likely(i < ROUTE_DATA_POOL_COUNT))
+		mempool_free(&pools.route_data[i], data);
+	else
+		free(data);
+}
+
+/** Point the arrays of \a r into \a data with room for \a capacity */
+static inline void
+route_set_data(struct route *r, void *data, int capacity)
+{
+	/** The block starts with the time-window data */
+	r->tw = data;
+	r->demand = (double *)(r->tw + capacity);
+	r->demand_pf = r->demand + capacity;
+	r->demand_sf = r->demand_pf + capacity;
+	r->customers = (struct customer **)(r->demand_sf + capacity);
+	r->capacity = capacity;
+}
+
+/** Copy the first \a n positions of \a src into \a dst */
+static inline void
+route_copy_positions(struct route *dst, struct route *src, int n)
+{
+	if (n <= 0)
+		return;
+	memcpy(dst->customers, src->customers, sizeof(src->customers[0]) * n);
+	memcpy(dst->tw, src->tw, sizeof(src->tw[0]) * n);
+	memcpy(dst->demand, src->demand, sizeof(src->demand[0]) * n);
+	memcpy(dst->demand_pf, src->demand_pf, sizeof(src->demand_pf[0]) * n);
+	memcpy(dst->demand_sf, src->demand_sf, sizeof(src->demand_sf[0]) * n);
+}
+
+void
+route_grow(struct route *r, int capacity)
+{
+	int new_capacity = MAX(r->capacity * 2, ROUTE_DATA_MIN_CAPACITY);
+	while (new_capacity < capacity)
+		new_capacity *= 2;
+	struct route old = *r;
+	route_set_data(r, route_data_alloc(new_capacity), new_capacity);
+	route_copy_positions(r, &old, MIN(old.size, old.capacity));
+	route_data_free(old.tw, old.capacity);
+}
+
 void
 route_init(struct route *r, struct customer **arr, int n)
 {
+	route_reserve(r, n + 2);
 	r->size = n + 2;
 	r->customers[0] = customer_dup(p.depot);
 	for (int j = 0; j < n; j++)
@@ -53,22 +140,38 @@ route_update_penalty(struct route *r, struct customer *forward_start,
 
 	c_penalty_update_forward(forward_start);
 	c_penalty_update_backward(backward_start);
-	tw_penalty_update_forward(forward_start);
-	tw_penalty_update_backward(backward_start);
+	tw_penalty_update(forward_start, backward_start);
+}
+
+/**
+ * Shift \a n customers starting at \a from to \a to together with
+ * their hot data. The static and suffix values stay valid for the
+ * shifted customers, the prefix values are recomputed by the forward
+ * update anyway.
+ */
+static inline void
+route_move_customers(struct route *r, int to, int from, int n)
+{
+	if (n <= 0)
+		return;
+	memmove(&r->customers[to], &r->customers[from],
+		sizeof(r->customers[0]) * n);
+	memmove(&r->tw[to], &r->tw[from], sizeof(r->tw[0]) * n);
+	memmove(&r->demand[to], &r->demand[from], sizeof(r->demand[0]) * n);
+	memmove(&r->demand_sf[to], &r->demand_sf[from],
+		sizeof(r->demand_sf[0]) * n);
 }
 
 void
 route_insert_customer(struct route *r, int idx, struct customer *c)
 {
 	assert(idx >= 0 && idx <= r->size);
-	assert(r->size < MAX_N_CUSTOMERS + 2);
-	if (idx < r->size) {
-		memmove(&r->customers[idx + 1], &r->customers[idx],
-			sizeof(r->customers[0]) * (r->size - idx));
-	}
+	route_reserve(r, r->size + 1);
+	route_move_customers(r, idx + 1, idx, r->size - idx);
 	r->customers[idx] = c;
+	route_load_customer_data(r, idx);
 	++r->size;
-	route_refresh_metadata_from(r, idx);
+	route_refresh_idx_from(r, idx);
 }
 
 struct customer *
@@ -76,37 +179,213 @@ route_remove_customer(struct route *r, int idx)
 {
 	assert(idx >= 0 && idx < r->size);
 	struct customer *removed = r->customers[idx];
-	if (idx + 1 < r->size) {
-		memmove(&r->customers[idx], &r->customers[idx + 1],
-			sizeof(r->customers[0]) * (r->size - idx - 1));
-	}
+	route_move_customers(r, idx, idx + 1, r->size - idx - 1);
 	--r->size;
-	route_refresh_metadata_from(r, idx);
+	route_refresh_idx_from(r, idx);
 	removed->route = NULL;
 	removed->idx = -1;
 	return removed;
 }
 
+void
+route_remove_customers(struct route *r, struct customer **cs, int n)
+{
+	if (n == 0)
+		return;
+	int first = cs[0]->idx;
+	int to = first;
+	for (int i = 0; i < n; i++) {
+		assert(cs[i]->route == r && cs[i]->idx > 0);
+		int from = cs[i]->idx + 1;
+		int end = i + 1 < n ? cs[i + 1]->idx : r->size;
+		assert(from <= end);
+		route_move_customers(r, to, from, end - from);
+		to += end - from;
+		cs[i]->route = NULL;
+		cs[i]->idx = -1;
+	}
+	r->size -= n;
+	route_refresh_idx_from(r, first);
+}
+
 /* TODO: deprecate */
 struct route *
 route_dup(struct route *r)
 {
-	struct route *dup = xmalloc(sizeof(*dup));
+	struct route *dup = route_new();
+	route_reserve(dup, r->size);
 	dup->size = r->size;
-	rlist_create(&dup->in_routes);
 	for (int i = 0; i < r->size; i++)
 		dup->customers[i] = customer_dup(r->customers[i]);
-	route_refresh_metadata_from(dup, 0);
+	route_refresh_idx_from(dup, 0);
+	route_copy_data(dup, r);
 	route_check(r);
 	return dup;
 }
 
+void
+route_copy_data(struct route *dst, struct route *src)
+{
+	assert(dst->size == src->size);
+	assert(dst->capacity >= src->size);
+	int n = src->size;
+	memcpy(dst->tw, src->tw, sizeof(src->tw[0]) * n);
+	memcpy(dst->demand, src->demand, sizeof(src->demand[0]) * n);
+	memcpy(dst->demand_pf, src->demand_pf, sizeof(src->demand_pf[0]) * n);
+	memcpy(dst->demand_sf, src->demand_sf, sizeof(src->demand_sf[0]) * n);
+}
+
 void
 route_delete(struct route *r)
 {
 	for (int i = 0; i < r->size; i++)
 		customer_delete(r->customers[i]);
-	free(r);
+	/** The hot data block starts with the time-window data */
+	route_data_free(r->tw, r->capacity);
+	mempool_free(&pools.route, r);
+}
+
+/**
+ * Delete a route removed from a solution. Its customers apart from the
+ * depots belong to someone else by now.
+ */
+static void
+route_delete_removed(struct route *r)
+{
+	customer_delete(depot_head(r));
+	customer_delete(depot_tail(r));
+	r->size = 0;
+	route_delete(r);
+}
+
+void
+route_journal_create(struct route_journal *j)
+{
+	j->undo = NULL;
+	j->size = 0;
+	j->capacity = 0;
+	j->depth = 0;
+}
+
+void
+route_journal_destroy(struct route_journal *j)
+{
+	assert(j->depth == 0);
+	assert(j->size == 0);
+	free(j->undo);
+}
+
+void
+route_journal_savepoint(struct route_journal *j)
+{
+	if (j->depth == ROUTE_JOURNAL_MAX_DEPTH)
+		panic("too many nested route journal savepoints");
+	j->frames[j->depth++] = j->size;
+}
+
+static struct route_undo *
+route_journal_push(struct route_journal *j, struct route *r)
+{
+	assert(j->depth > 0);
+	if (unlikely(j->size == j->capacity)) {
+		j->capacity = MAX(2 * j->capacity, 16);
+		j->undo = xrealloc(j->undo, sizeof(j->undo[0]) * j->capacity);
+	}
+	struct route_undo *u = &j->undo[j->size++];
+	u->route = r;
+	u->data = NULL;
+	u->size = r->size;
+	u->capacity = r->capacity;
+	u->removed_idx = -1;
+	u->depth = r->journal_depth;
+	return u;
+}
+
+void
+route_journal_save(struct route *r)
+{
+	struct route_journal *j = r->journal;
+	assert(r->journal_depth < j->depth);
+	struct route_undo *u = route_journal_push(j, r);
+	u->data = route_data_alloc(r->capacity);
+	struct route saved;
+	route_set_data(&saved, u->data, r->capacity);
+	route_copy_positions(&saved, r, r->size);
+	r->journal_depth = j->depth;
+}
+
+void
+route_journal_remove(struct route_journal *j, struct route **routes,
+		     int *n_routes, int idx)
+{
+	assert(idx >= 0 && idx < *n_routes);
+	struct route *r = routes[idx];
+	SWAP(routes[idx], routes[*n_routes - 1]);
+	--(*n_routes);
+	if (j->depth == 0) {
+		route_delete_removed(r);
+		return;
+	}
+	struct route_undo *u = route_journal_push(j, r);
+	u->removed_idx = idx;
+}
+
+void
+route_journal_rollback(struct route_journal *j, struct route **routes,
+		       int *n_routes)
+{
+	assert(j->depth > 0);
+	int start = j->frames[--j->depth];
+	for (int i = j->size - 1; i >= start; i--) {
+		struct route_undo *u = &j->undo[i];
+		struct route *r = u->route;
+		if (u->data == NULL) {
+			/** Undo route_journal_remove() */
+			routes[*n_routes] = routes[u->removed_idx];
+			routes[u->removed_idx] = r;
+			++(*n_routes);
+			route_refresh_idx_from(r, 0);
+			continue;
+		}
+		route_data_free(r->tw, r->capacity);
+		route_set_data(r, u->data, u->capacity);
+		r->size = u->size;
+		r->journal_depth = u->depth;
+		route_refresh_idx_from(r, 0);
+		route_check(r);
+	}
+	j->size = start;
+}
+
+void
+route_journal_release(struct route_journal *j)
+{
+	assert(j->depth > 0);
+	int start = j->frames[--j->depth];
+	int size = start;
+	for (int i = start; i < j->size; i++) {
+		struct route_undo *u = &j->undo[i];
+		struct route *r = u->route;
+		if (u->data == NULL) {
+			if (j->depth == 0)
+				route_delete_removed(r);
+			else
+				j->undo[size++] = *u;
+			continue;
+		}
+		/**
+		 * The route must stay saved for the enclosing savepoint
+		 * unless it has already been saved for it.
+		 */
+		if (u->depth < j->depth) {
+			r->journal_depth = j->depth;
+			j->undo[size++] = *u;
+			continue;
+		}
+		r->journal_depth = u->depth;
+		route_data_free(u->data, u->capacity);
+	}
+	j->size = size;
 }
 
 struct customer *
@@ -129,6 +408,24 @@ route_feasible(struct route *r)
 	return (tw_penalty_get_penalty(r) < EPS5 && c_penalty_get_penalty(r) < EPS5);
 }
 
+bool
+route_feasible_exact(struct route *r)
+{
+	if (c_penalty_get_penalty(r) >= EPS5)
+		return false;
+	struct customer *prev = depot_head(r);
+	double a = prev->e;
+	for (int i = 1; i < r->size; i++) {
+		struct customer *next = r->customers[i];
+		a += prev->s + problem_customer_distance(prev, next);
+		if (a > next->l + EPS5)
+			return false;
+		a = MAX(a, next->e);
+		prev = next;
+	}
+	return true;
+}
+
 double
 route_penalty(struct route *r, double alpha, double beta)
 {
@@ -148,24 +445,41 @@ route_len(struct route *r)
 }
 */
 
+void
+route_get_insert_deltas(struct route *r, struct customer *w,
+			double alpha, double beta, double *delta)
+{
+	assert(is_ejected(w));
+	tw_penalty_get_insert_penalties(r, w, delta);
+	/** The capacity penalty does not depend on the position */
+	double c_delta = c_penalty_get_insert_delta_inline(depot_tail(r), w);
+	double tw_penalty = tw_penalty_get_penalty_inline(r);
+	for (int i = 1; i < r->size; i++)
+		delta[i] = alpha * c_delta + beta * (delta[i] - tw_penalty);
+}
+
 struct modification
 route_find_optimal_insertion(struct route *r, struct customer *w,
-				double alpha, double beta)
+			     double alpha, double beta, double *opt_delta)
 {
 	assert(is_ejected(w));
+	struct region *gc = &fiber()->gc;
+	size_t gc_used = region_used(gc);
+	double *delta = xregion_alloc_array(gc, double, r->size);
+	route_get_insert_deltas(r, w, alpha, beta, delta);
 	struct modification opt_modification =
 		modification_new(INSERT, NULL, NULL);
 	double opt_penalty = INFINITY;
 	for (int i = 1; i < r->size; i++) {
-		struct customer *v = r->customers[i];
-		struct modification m = modification_new(INSERT, v, w);
-		double penalty = modification_delta(m, alpha, beta);
-		if (penalty < opt_penalty) {
-			if (penalty < EPS5)
-				return m;
-			opt_modification = m;
-			opt_penalty = penalty;
+		if (delta[i] < opt_penalty) {
+			opt_modification =
+				modification_new(INSERT, r->customers[i], w);
+			opt_penalty = delta[i];
+			if (opt_penalty < EPS5)
+				break;
 		}
 	}
+	region_truncate(gc, gc_used);
+	*opt_delta = opt_penalty;
 	return opt_modification;
 }
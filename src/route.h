@@ -10,11 +10,85 @@
 extern "C" {
 #endif /* defined(__cplusplus) */
 
+/**
+ * Time-window data of the customer at some position of a route. It is
+ * everything tw_penalty reads about a position, packed into 64 bytes
+ * so that a penalty lookup touches one small record per position.
+ */
+struct route_tw_data {
+    double e;
+    double l;
+    double s;
+    /** Prefix values */
+    double a;
+    double tw_pf;
+    /** Suffix values */
+    double z;
+    double tw_sf;
+    int id;
+};
+
 struct route {
-    struct customer *customers[MAX_N_CUSTOMERS + 2];
+    /** Customers in the route order, including both depots */
+    struct customer **customers;
     int size;
+    /**
+     * Hot data used by penalty calculations, indexed by the position
+     * in the route. It is kept apart from the customers, which also
+     * carry the data used by the rest of the algorithm. Everything,
+     * including the customers array, lives in a single block with
+     * room for `capacity` positions, see route_reserve().
+     *
+     * The static customer attributes are copied by
+     * route_refresh_metadata_from(), the prefix and suffix values are
+     * maintained by tw_penalty and c_penalty.
+     */
+    int capacity;
+    struct route_tw_data *tw;
+    double *demand;
+    double *demand_pf;
+    double *demand_sf;
     struct rlist in_routes;
     int in_infeasibles_idx;
+    /** The journal the route is recorded in, may be NULL */
+    struct route_journal *journal;
+    /** The newest savepoint the route has been saved for, 0 if none */
+    int journal_depth;
+};
+
+/** Maximum number of nested savepoints of a route journal */
+#define ROUTE_JOURNAL_MAX_DEPTH 8
+
+/** Saved state of a route, see struct route_journal */
+struct route_undo {
+    struct route *route;
+    /**
+     * Copy of the route data block, NULL if the entry records the
+     * removal of the route, see route_journal_remove().
+     */
+    void *data;
+    int size;
+    int capacity;
+    /** Index the route was removed from */
+    int removed_idx;
+    /** route::journal_depth before the route was saved */
+    int depth;
+};
+
+/**
+ * Undo log of the routes of a solution. Opening a savepoint costs
+ * nothing: a route is copied the first time it is modified after the
+ * newest savepoint, see route_journal_touch(). So rolling back costs
+ * as much as the routes that have actually changed.
+ */
+struct route_journal {
+    struct route_undo *undo;
+    int size;
+    int capacity;
+    /** Number of open savepoints */
+    int depth;
+    /** Position in undo where each open savepoint starts */
+    int frames[ROUTE_JOURNAL_MAX_DEPTH];
 };
 
 #define route_foreach(c, r) \
@@ -40,14 +114,53 @@ route_non_depot_size(struct route *r)
 	return r->size - 2;
 }
 
+/** Size of the data block of a route with \a capacity positions */
+size_t
+route_data_size(int capacity);
+
+void
+route_grow(struct route *r, int capacity);
+
+/** Make sure the route has room for at least \a size customers */
+static ALWAYS_INLINE void
+route_reserve(struct route *r, int size)
+{
+	if (unlikely(size > r->capacity))
+		route_grow(r, size);
+}
+
+/** Copy the static data of the customer at position \a i */
+static ALWAYS_INLINE void
+route_load_customer_data(struct route *r, int i)
+{
+	struct customer *c = r->customers[i];
+	r->tw[i].id = c->id;
+	r->tw[i].e = c->e;
+	r->tw[i].l = c->l;
+	r->tw[i].s = c->s;
+	r->demand[i] = c->demand;
+}
+
+/** Update positions of the customers starting from \a start_idx */
+static ALWAYS_INLINE void
+route_refresh_idx_from(struct route *r, int start_idx)
+{
+	for (int i = start_idx; i < r->size; i++) {
+		r->customers[i]->route = r;
+		r->customers[i]->idx = i;
+	}
+}
+
 static ALWAYS_INLINE void
 route_refresh_metadata_from(struct route *r, int start_idx)
 {
+	assert(r->size <= r->capacity);
 	if (start_idx < 0)
 		start_idx = 0;
 	for (int i = start_idx; i < r->size; i++) {
 		r->customers[i]->route = r;
 		r->customers[i]->idx = i;
+		route_load_customer_data(r, i);
 	}
 }
 
@@ -64,6 +177,7 @@ route_check(struct route *r)
 		assert(c->route == r);
 		assert(c->idx >= 0 && c->idx < r->size);
 		assert(r->customers[c->idx] == c);
+		assert(r->tw[c->idx].id == c->id);
 	}
 #endif
 }
@@ -77,6 +191,12 @@ route_init(struct route *r, struct customer **arr, int n);
 void
 route_init_penalty(struct route *r);
 
+/**
+ * Update the penalty data after the customers at the positions
+ * [\a forward_start, \a backward_start] were replaced. An empty range,
+ * i.e. \a backward_start right before \a forward_start, means that only
+ * the link between them has changed.
+ */
 void
 route_update_penalty(struct route *r, struct customer *forward_start,
 		     struct customer *backward_start);
@@ -87,27 +207,102 @@ route_insert_customer(struct route *r, int idx, struct customer *c);
 struct customer *
 route_remove_customer(struct route *r, int idx);
 
+/**
+ * Remove the customers \a cs, given in the route order, in a single
+ * pass over the route. The penalty data is left to the caller, see
+ * route_update_penalty().
+ */
+void
+route_remove_customers(struct route *r, struct customer **cs, int n);
+
 struct route *
 route_dup(struct route *r);
 
+/**
+ * Copy the penalty data of \a src into \a dst, which must hold
+ * copies of the same customers in the same order.
+ */
+void
+route_copy_data(struct route *dst, struct route *src);
+
 void
 route_delete(struct route *r);
 
+void
+route_journal_create(struct route_journal *j);
+
+void
+route_journal_destroy(struct route_journal *j);
+
+void
+route_journal_savepoint(struct route_journal *j);
+
+/** Save \a r for the newest savepoint of its journal */
+void
+route_journal_save(struct route *r);
+
+/** Must be called before \a r is modified */
+static ALWAYS_INLINE void
+route_journal_touch(struct route *r)
+{
+	if (r->journal != NULL && r->journal_depth < r->journal->depth)
+		route_journal_save(r);
+}
+
+/**
+ * Remove routes[idx] by moving the last route in its place. Without
+ * an open savepoint the route is deleted, otherwise it is kept until
+ * the removal is either rolled back or released. The customers of the
+ * route apart from the depots are left to the caller.
+ */
+void
+route_journal_remove(struct route_journal *j, struct route **routes,
+		     int *n_routes, int idx);
+
+/** Restore the routes as they were at the newest savepoint */
+void
+route_journal_rollback(struct route_journal *j, struct route **routes,
+		       int *n_routes);
+
+/** Close the newest savepoint keeping all the changes */
+void
+route_journal_release(struct route_journal *j);
+
 struct customer *
 route_find_customer_by_id(struct route *r, int id);
 
 bool
 route_feasible(struct route *r);
 
+/**
+ * Check time windows along the route using full-precision
+ * distances instead of the (possibly rounded) distance matrix.
+ */
+bool
+route_feasible_exact(struct route *r);
+
 double
 route_penalty(struct route *r, double alpha, double beta);
 
 //int
 //route_len(struct route *r);
 
+/**
+ * modification_delta() of inserting \a w before each customer of \a r
+ * but the first depot: delta[i] for position i in [1, r->size).
+ */
+void
+route_get_insert_deltas(struct route *r, struct customer *w,
+			double alpha, double beta, double *delta);
+
+/**
+ * The first insertion of \a w into \a r with a negligible delta or
+ * else the first one with the minimum delta, which is stored in
+ * \a opt_delta.
+ */
 struct modification
 route_find_optimal_insertion(struct route *r, struct customer *w,
-			     double alpha, double beta);
+			     double alpha, double beta, double *opt_delta);
 
 #if defined(__cplusplus)
 }
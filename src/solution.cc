@@ -2,6 +2,8 @@
 
 #include "dist.h"
 #include "modification.h"
+#include "neighbours.h"
+#include "penalty_inline.h"
 
 #include <cassert>
 #include <cstdio>
@@ -21,45 +23,21 @@ struct solution_meta {
     customer *idx[0];
 };
 
-bool solution_global_initialized = false;
-
-/**
- * Arrays of neighbours sorted by dist from particular customer.
- * There are no depot in this arrays. Depots are processed separately.
- */
-int neighbours_sorted[MAX_N_CUSTOMERS][MAX_N_CUSTOMERS];
+/** Rank the neighbours by time-window relatedness, see neighbours_init() */
+bool tw_neighbours = false;
 
 void
-init_neighbours_sorted()
+solution_set_tw_neighbours(bool enable)
 {
-	std::vector<customer *> cs(p.n_customers + 1);
-	cs[0] = p.depot;
-	{
-		customer *c;
-		rlist_foreach_entry(c, &p.customers, in_route) cs[c->id] = c;
-	}
-	assert(cs.begin() != cs.end());
-
-#define init_row() {				\
-std::sort(cs.begin() + 1, cs.end(),		\
-        [c](customer *a, customer *b) {		\
-    	return dist(c, a) < dist(c, b); });	\
-std::transform(cs.begin() + 1, cs.end(),	\
-       std::begin(neighbours_sorted[c->id]),	\
-       [](customer *c) { return c->id; });	\
-} while(0)
-	struct customer *c = p.depot;
-	init_row();
-	rlist_foreach_entry(c, &p.customers, in_route)
-		init_row();
-#undef init_row
+	tw_neighbours = enable;
 }
 
 struct modification_neighbourhood_args {
 	solution *s;
 	route *r;
 	int n_near;
-	modification *m;
+	modification_visitor_f visit;
+	void *visit_arg;
 };
 
 /**
@@ -67,19 +45,24 @@ struct modification_neighbourhood_args {
  * out-relocate modifications
  */
 struct intra_route_out_relocate_data {
-	route *r;
 	customer *w;
-	customer *id_to_customer[MAX_N_CUSTOMERS];
 	double tw_penalty_delta;
+	/** Time-window data of the route of w with w ejected */
+	int size;
+	struct route_tw_data *tw;
 };
 
 struct modification_neighbourhood_data {
 	modification_neighbourhood_args args;
+	/** The modification being visited */
+	modification m;
 	intra_route_out_relocate_data out_relocate_current;
+	/** segment summaries of the route for intra-route exchanges */
+	tw_segment_table segments;
 	/** number of customers in route (excluding depots) */
 	int n;
 	/** random permutation of route customers (excluding depots) */
-	customer *permutation[MAX_N_CUSTOMERS];
+	customer **permutation;
 };
 
 void
@@ -89,13 +72,16 @@ intra_route_out_relocate_init_delta(
 {
 	intra_route_out_relocate_data *d =
 		&data->out_relocate_current;
-	v = d->id_to_customer[v->id];
-	assert(modification_applicable(
-		modification_new(INSERT, v, d->w)));
-	data->args.m->delta_initialized = true;
-	data->args.m->tw_penalty_delta = d->tw_penalty_delta +
-					 tw_penalty_get_insert_delta(v, d->w);
-	data->args.m->c_penalty_delta = 0.;
+	assert(v->route == d->w->route && v->id != 0);
+	/** Position of v in the route without w */
+	int idx = v->idx - (int)(v->idx > d->w->idx);
+	assert(idx > 0);
+	data->m.delta_initialized = true;
+	data->m.tw_penalty_delta = d->tw_penalty_delta +
+		(tw_penalty_insert_between_inline(&d->tw[idx - 1], &d->tw[idx],
+						  d->w) -
+		 d->tw[d->size - 1].tw_pf);
+	data->m.c_penalty_delta = 0.;
 }
 
 /** out-relocate to the tail of some route */
@@ -118,20 +104,26 @@ out_relocation_to_depot_tails(
 	}
 }*/
 
-void
+/** Visit the current modification, returns true to stop */
+static inline bool
+modification_neighbourhood_visit(modification_neighbourhood_data *data)
+{
+	return data->args.visit(&data->m, data->args.visit_arg);
+}
+
+/** Returns true if the enumeration must be stopped */
+bool
 inter_route_modifications(
 	modification_neighbourhood_data *data,
 	customer *v, customer *w)
 {
 	assert(v->route != w->route);
-	modification_neighbourhood_args *a = &data->args;
-
-#define yield_modification(_type) do {					\
-	*a->m = modification_new((_type), v, w);			\
-	assert(modification_applicable(*a->m));			\
-	fiber_yield();							\
-	if (fiber_is_cancelled())					\
-		return;							\
+
+#define visit_modification(_type) do {					\
+	data->m = modification_new((_type), v, w);			\
+	assert(modification_applicable(data->m));			\
+	if (modification_neighbourhood_visit(data))			\
+		return true;						\
 } while (0)
 
 	/*
@@ -141,25 +133,27 @@ inter_route_modifications(
 	 */
 	if (w->id == 0) {
 		if (w == depot_tail(w->route))
-			return;
+			return false;
 		if (v->id != 0)
-			yield_modification(TWO_OPT);
-		return;
+			visit_modification(TWO_OPT);
+		return false;
 	}
 
 	if (v->id == 0) {
-		yield_modification(OUT_RELOCATE);
-		return;
+		visit_modification(OUT_RELOCATE);
+		return false;
 	}
 
-	yield_modification(TWO_OPT);
-	yield_modification(OUT_RELOCATE);
-	yield_modification(EXCHANGE);
+	visit_modification(TWO_OPT);
+	visit_modification(OUT_RELOCATE);
+	visit_modification(EXCHANGE);
+	return false;
 
-#undef yield_modification
+#undef visit_modification
 }
 
-void
+/** Returns true if the enumeration must be stopped */
+bool
 intra_route_modifications(
 	modification_neighbourhood_data *data,
 	customer *v, customer *w)
@@ -167,44 +161,41 @@ intra_route_modifications(
 	assert(v->route == w->route);
 	assert(w->id == data->out_relocate_current.w->id);
 	if (v->id == 0 || w->id == 0)
-		return;
-	modification_neighbourhood_args *a = &data->args;
+		return false;
+	modification *m = &data->m;
 	/** out-relocate */
-	*a->m = modification_new(OUT_RELOCATE, v, w);
-	if (modification_applicable(*a->m)) {
+	*m = modification_new(OUT_RELOCATE, v, w);
+	if (modification_applicable(*m)) {
 		intra_route_out_relocate_init_delta(data, v);
-		fiber_yield();
-		if (fiber_is_cancelled())
-			return;
+		if (modification_neighbourhood_visit(data))
+			return true;
 	}
 	/** exchange */
-	bool exact;
-	*a->m = modification_new(EXCHANGE, v, w);
-	if (modification_applicable(*a->m)) {
-		a->m->tw_penalty_delta =
-			tw_penalty_exchange_penalty_delta_lower_bound(v, w, &exact);
-		if (exact) {
-			a->m->delta_initialized = true;
-			a->m->c_penalty_delta = 0.;
-			fiber_yield();
-			if (fiber_is_cancelled())
-				return;
-		}
+	*m = modification_new(EXCHANGE, v, w);
+	if (modification_applicable(*m)) {
+		m->tw_penalty_delta = tw_penalty_intra_route_exchange_delta(
+			&data->segments, v, w);
+		m->delta_initialized = true;
+		m->c_penalty_delta = 0.;
+		if (modification_neighbourhood_visit(data))
+			return true;
 	}
+	return false;
 }
 
 void
 modification_neighbourhood_data_init(
 	modification_neighbourhood_data *data,
-	va_list ap)
+	solution *s, route *r, int n_near,
+	modification_visitor_f visit, void *visit_arg)
 {
-	data->args.s = va_arg(ap, solution *);
-	data->args.r = va_arg(ap, route *);
-	data->args.n_near = va_arg(ap, int);
-	data->args.m = va_arg(ap, modification *);
+	data->args.s = s;
+	data->args.r = r;
+	data->args.n_near = n_near;
+	data->args.visit = visit;
+	data->args.visit_arg = visit_arg;
 
 	data->out_relocate_current.w = nullptr;
-	data->out_relocate_current.r = nullptr;
 	/**
 	 * To diversify the search a little, we consider the vertices
 	 * of the route in random order.
@@ -222,58 +213,37 @@ intra_route_out_relocate_data_create(
 	customer *w)
 {
 	assert(w->id != 0);
-	/** WARNING: ALLOCATION! */
-	data->r = route_dup(w->route);
-	customer *v;
-	route_foreach(v, data->r)
-		data->id_to_customer[v->id] = v;
-	data->w = data->id_to_customer[w->id];
-	auto m = modification_new(EJECT, data->w, nullptr);
-	assert(modification_applicable(m));
-	data->tw_penalty_delta = tw_penalty_get_eject_delta(data->w);
-	modification_apply(m);
+	data->w = w;
+	data->tw_penalty_delta = tw_penalty_get_eject_delta(w);
+	data->size = w->route->size - 1;
+	tw_penalty_eject_into(w->route, w->idx, data->tw);
 }
 
 void
-intra_route_out_relocate_data_destroy(intra_route_out_relocate_data *data)
+solution_global_init(int n_near)
 {
-	if (data->r != nullptr) {
-		route_delete(data->r);
-		data->r = nullptr;
-	}
-	if (data->w != nullptr) {
-		customer_delete(data->w);
-		data->w = nullptr;
-	}
+	if (unlikely(!neighbours_ready(n_near, tw_neighbours)))
+		neighbours_init(n_near, tw_neighbours);
 }
 
 void
-modification_neighbourhood_data_destroy(modification_neighbourhood_data *data)
+solution_modification_neighbourhood(solution *s, route *r, int n_near,
+				    modification_visitor_f visit,
+				    void *visit_arg)
 {
-	intra_route_out_relocate_data_destroy(&data->out_relocate_current);
-}
-
-void
-solution_global_init()
-{
-	if (unlikely(!solution_global_initialized)) {
-		init_neighbours_sorted();
-		solution_global_initialized = true;
-	}
-}
-
-int
-solution_modification_neighbourhood_f(va_list ap)
-{
-	if(!solution_global_initialized)
-		solution_global_init();
+	solution_global_init(n_near);
 
+	region *gc = &fiber()->gc;
+	size_t gc_used = region_used(gc);
 	modification_neighbourhood_data *data =
-		xregion_alloc_object(&fiber()->gc, typeof(*data));
-	data->out_relocate_current.r = nullptr;
-
-	modification_neighbourhood_data_init(data, ap);
-	struct solution *s = data->args.s;
+		xregion_alloc_object(gc, typeof(*data));
+	data->permutation = xregion_alloc_array(gc, customer *, r->size);
+	data->out_relocate_current.tw =
+		xregion_alloc_array(gc, struct route_tw_data, r->size);
+
+	modification_neighbourhood_data_init(data, s, r, n_near,
+					     visit, visit_arg);
+	tw_segment_table_create(&data->segments, r, gc);
 	solution_check_routes(s);
 	struct customer **idx = s->meta->idx;
 
@@ -283,21 +253,20 @@ solution_modification_neighbourhood_f(va_list ap)
 	 * inapplicable modifications
 	 */							\
         if (v != w && !is_ejected(v)) {				\
-        	if (v->route != w->route)			\
-        	        inter_route_modifications(data, v, w);	\
-        	else if (w->id != 0)				\
-        	        intra_route_modifications(data, v, w);	\
+        	if (v->route != w->route) {			\
+        	        if (inter_route_modifications(data, v, w))	\
+				goto finish;			\
+		} else if (w->id != 0) {			\
+        	        if (intra_route_modifications(data, v, w))	\
+				goto finish;			\
+		}						\
 	}							\
-	if (fiber_is_cancelled())				\
-                goto finish;					\
 } while(0)
 	customer *v;
 	for (int j = 0; j < data->n; j++) {
 		customer *w = data->permutation[j];
 		if (w->id != 0) {
 			/** prepare for intra-route out-relocate */
-			intra_route_out_relocate_data_destroy(
-				&data->out_relocate_current);
 			intra_route_out_relocate_data_create(
 				&data->out_relocate_current, w);
 			/**
@@ -310,16 +279,37 @@ solution_modification_neighbourhood_f(va_list ap)
 				check_modifications();
 			}
 		}
+		const int *near = neighbours_row(w->id);
 		for (int i = 0; i < MIN(data->args.n_near, p.n_customers); i++) {
-			assert(neighbours_sorted[w->id][i] != 0);
-			v = idx[neighbours_sorted[w->id][i]];
+			assert(near[i] != 0);
+			v = idx[near[i]];
 			check_modifications();
 		}
 	}
+#undef check_modifications
 
 finish:
-	modification_neighbourhood_data_destroy(data);
-	region_truncate(&fiber()->gc, 0);
+	region_truncate(gc, gc_used);
+}
+
+/** Pass the modification to the caller of the fiber */
+static bool
+modification_neighbourhood_yield(modification *m, void *arg)
+{
+	*(modification *)arg = *m;
+	fiber_yield();
+	return fiber_is_cancelled();
+}
+
+int
+solution_modification_neighbourhood_f(va_list ap)
+{
+	solution *s = va_arg(ap, solution *);
+	route *r = va_arg(ap, route *);
+	int n_near = va_arg(ap, int);
+	modification *m = va_arg(ap, modification *);
+	solution_modification_neighbourhood(s, r, n_near,
+					    modification_neighbourhood_yield, m);
 	return 0;
 }
 
@@ -382,42 +372,27 @@ solution_routing_cost(solution *s)
 		for (customer *curr = route_next(prev);
 		     curr != depot_tail(r);
 		     curr = route_next(curr)) {
-			total += dist(prev, curr);
+			total += problem_customer_distance(prev, curr);
 			prev = curr;
 		}
-		total += dist(prev, depot_tail(r));
+		total += problem_customer_distance(prev, depot_tail(r));
 	}
 	return total;
 }
 
-void
-solution_print_incumbent_json(solution *s, long elapsed_ms)
-{
-	printf(
-		"incumbent_solution_json: "
-		"{\"elapsed_ms\":%ld,\"num_routes\":%d,\"native_cost\":%.12f,\"routes\":[",
-		elapsed_ms,
-		s->n_routes,
-		solution_routing_cost(s)
-	);
-	for (int i = 0; i < s->n_routes; i++) {
-		if (i > 0)
-			printf(",");
-		printf("[");
-		bool first_customer = true;
-		customer *c;
-		route_foreach(c, s->routes[i]) {
-			if (c->id == 0)
-				continue;
-			if (!first_customer)
-				printf(",");
-			printf("%d", c->id);
-			first_customer = false;
-		}
-		printf("]");
-	}
-	printf("]}\n");
-	fflush(stdout);
+static void
+solution_journal_create(solution *s)
+{
+	route_journal_create(&s->journal);
+	rlist_create(&s->ejection_history);
+}
+
+/** Make the routes record their changes in the journal of \a s */
+static void
+solution_attach_routes(solution *s)
+{
+	for (int i = 0; i < s->n_routes; i++)
+		s->routes[i]->journal = &s->journal;
 }
 
 solution *
@@ -434,6 +409,7 @@ solution_default(void)
 	assert(rlist_empty(&problem_customers));
 
 	rlist_create(&s->ejection_pool);
+	solution_journal_create(s);
 	s->n_routes = p.n_customers;
 	int i = 0;
 	customer *c;
@@ -444,6 +420,7 @@ solution_default(void)
 		++i;
 	}
 	assert(i == p.n_customers);
+	solution_attach_routes(s);
 	return s;
 }
 
@@ -480,8 +457,7 @@ solution_decode(const char *file)
 		panic("solution_decode: file '%s' contains no routes", file);
 
 	/* Validate: all customers present exactly once, no depot, in range */
-	bool used[MAX_N_CUSTOMERS + 1];
-	memset(used, 0, sizeof(used));
+	std::vector<bool> used(p.n_customers + 1);
 	int total_customers = 0;
 
 	for (int ri = 0; ri < (int)parsed_routes.size(); ri++) {
@@ -519,21 +495,24 @@ solution_decode(const char *file)
 	assert(rlist_empty(&problem_customers));
 
 	rlist_create(&s->ejection_pool);
+	solution_journal_create(s);
 	s->n_routes = (int)parsed_routes.size();
 
 	/* Temp array for route_init */
-	struct customer *arr[MAX_N_CUSTOMERS];
+	std::vector<struct customer *> arr;
 
 	for (int i = 0; i < s->n_routes; i++) {
 		const auto &rids = parsed_routes[i];
 		int n = (int)rids.size();
+		arr.resize(n);
 		for (int j = 0; j < n; j++)
 			arr[j] = s->meta->idx[rids[j]];
 
 		route *r = route_new();
-		route_init(r, arr, n);
+		route_init(r, arr.data(), n);
 		s->routes[i] = r;
 	}
+	solution_attach_routes(s);
 
 	/* Post-build validation */
 	solution_check_missed_customers(s);
@@ -560,6 +539,7 @@ solution_dup(solution *s)
 	dup->w = ((s->w != nullptr) ? dup->meta->idx[s->w->id] : nullptr);
 
 	rlist_create(&dup->ejection_pool);
+	solution_journal_create(dup);
 	customer *c;
 	rlist_foreach_entry(c, &s->ejection_pool, in_eject) {
 		assert(c->id != 0);
@@ -568,17 +548,19 @@ solution_dup(solution *s)
 	dup->n_routes = s->n_routes;
 	for (int i = 0; i < dup->n_routes; i++) {
 		route *r = route_new();
+		route_reserve(r, s->routes[i]->size);
 		r->size = s->routes[i]->size;
 		route_foreach(c, s->routes[i]) {
 			auto c_dup = (c->id == 0) ? customer_dup(c) :
 				dup->meta->idx[c->id];
 			r->customers[c->idx] = c_dup;
 		}
-		route_refresh_metadata_from(r, 0);
-		route_init_penalty(r);
+		route_refresh_idx_from(r, 0);
+		route_copy_data(r, s->routes[i]);
 		route_check(r);
 		dup->routes[i] = r;
 	}
+	solution_attach_routes(dup);
 	return dup;
 }
 
@@ -592,6 +574,9 @@ solution_move(solution *dst, solution *src)
 	for (int i = 0; i < MAX(dst->n_routes, src->n_routes); i++)
 		SWAP(dst->routes[i], src->routes[i]);
 	SWAP(dst->n_routes, src->n_routes);
+	assert(dst->journal.depth == 0 && src->journal.depth == 0);
+	solution_attach_routes(dst);
+	solution_attach_routes(src);
 	solution_check_missed_customers(src);
 	solution_delete(src);
 }
@@ -600,15 +585,85 @@ void
 solution_delete(solution *s)
 {
 	solution_meta_delete(s->meta);
-	free(s->w);
+	if (s->w != nullptr)
+		customer_delete(s->w);
 	struct customer *c, *tmp;
 	rlist_foreach_entry_safe(c, &s->ejection_pool, in_eject, tmp)
 		customer_delete(c);
 	for (int i = 0; i < s->n_routes; i++)
 		route_delete(s->routes[i]);
+	route_journal_destroy(&s->journal);
+	rlist_persistent_forget_history(&s->ejection_history);
 	free(s);
 }
 
+void
+solution_savepoint(solution *s)
+{
+	route_journal_savepoint(&s->journal);
+	int i = s->journal.depth - 1;
+	s->savepoints[i].w = s->w;
+	s->savepoints[i].ejection_pool =
+		rlist_persistent_create_svp(&s->ejection_history);
+}
+
+void
+solution_rollback_to_savepoint(solution *s)
+{
+	route_journal_rollback(&s->journal, s->routes, &s->n_routes);
+	int i = s->journal.depth;
+	rlist_persistent_rollback_to_svp(&s->ejection_history,
+					 s->savepoints[i].ejection_pool);
+	s->w = s->savepoints[i].w;
+	/*
+	 * Customers ejected at the savepoint may still point to the
+	 * routes they have been inserted into since then.
+	 */
+	customer *c;
+	rlist_foreach_entry(c, &s->ejection_pool, in_eject) {
+		c->route = nullptr;
+		c->idx = -1;
+	}
+	if (s->w != nullptr) {
+		s->w->route = nullptr;
+		s->w->idx = -1;
+	}
+	if (s->journal.depth == 0)
+		assert(rlist_empty(&s->ejection_history));
+	solution_check_routes(s);
+	solution_check_missed_customers(s);
+}
+
+void
+solution_release_savepoint(solution *s)
+{
+	route_journal_release(&s->journal);
+	if (s->journal.depth == 0)
+		rlist_persistent_forget_history(&s->ejection_history);
+}
+
+void
+solution_ejection_pool_push(solution *s, customer *c)
+{
+	if (s->journal.depth == 0)
+		rlist_add_tail_entry(&s->ejection_pool, c, in_eject);
+	else
+		rlist_persistent_add_tail_entry(&s->ejection_history,
+						&s->ejection_pool, c, in_eject);
+}
+
+customer *
+solution_ejection_pool_pop(solution *s)
+{
+	assert(!rlist_empty(&s->ejection_pool));
+	customer *c = rlist_last_entry(&s->ejection_pool, customer, in_eject);
+	if (s->journal.depth == 0)
+		rlist_del_entry(c, in_eject);
+	else
+		rlist_persistent_del_entry(&s->ejection_history, c, in_eject);
+	return c;
+}
+
 double
 solution_penalty(struct solution *s, double alpha, double beta)
 {
@@ -627,6 +682,15 @@ solution_feasible(solution *s)
 	return true;
 }
 
+bool
+solution_feasible_exact(solution *s)
+{
+	for(int i = 0; i < s->n_routes; i++)
+		if (!route_feasible_exact(s->routes[i]))
+			return false;
+	return true;
+}
+
 /*
 int
 split_by_feasibility(solution *s)
@@ -646,33 +710,52 @@ struct modification
 solution_find_feasible_insertion(struct solution *s, struct customer *w)
 {
 	assert(is_ejected(w));
-	if (!solution_global_initialized)
-		solution_global_init();
-#define check_insertion() do {						\
-	struct modification m = modification_new(INSERT, v, w);		\
-	if (modification_applicable(m)) {				\
-		double penalty = modification_delta(m, 1., 1.);		\
-		if (penalty < EPS5) {					\
-			++n_feasible_insertions;				\
-			if (randint(1, n_feasible_insertions) == 1)	\
-				selected = m;				\
-		}							\
+	/**
+	 * Evaluate all the insertions route by route first, then pick
+	 * one in the order of the stored neighbour row of w, i.e. by
+	 * (key, id), and the customers out of the row by id. Nothing is
+	 * ranked here, a call costs O(n) however long the row is.
+	 */
+	region *gc = &fiber()->gc;
+	size_t gc_used = region_used(gc);
+	bool *feasible = xregion_alloc_array(gc, bool, p.n_customers + 1);
+	bool *tail_feasible = xregion_alloc_array(gc, bool, s->n_routes);
+	double *delta = xregion_alloc_array(gc, double, p.n_customers + 2);
+	memset(feasible, 0, sizeof(feasible[0]) * (p.n_customers + 1));
+	for (int i = 0; i < s->n_routes; i++) {
+		route *r = s->routes[i];
+		route_get_insert_deltas(r, w, 1., 1., delta);
+		for (int j = 1; j + 1 < r->size; j++)
+			feasible[r->customers[j]->id] = delta[j] < EPS5;
+		tail_feasible[i] = delta[r->size - 1] < EPS5;
+	}
+#define check_insertion(_feasible) do {					\
+	if (_feasible) {						\
+		++n_feasible_insertions;				\
+		if (randint(1, n_feasible_insertions) == 1)		\
+			selected = modification_new(INSERT, v, w);	\
 	}								\
 } while (0)
 	int n_feasible_insertions = 0;
 	struct modification selected = modification_new(INSERT, nullptr, w);
 	customer *v;
-	for (int i = 0; i < p.n_customers; i++) {
-		int id = neighbours_sorted[w->id][i];
-		assert(id != 0);
+	/** No rows are built if the neighbourhoods were never searched */
+	const int *row = neighbours_k() > 0 ? neighbours_row(w->id) : nullptr;
+	for (int i = 0; row != nullptr && i < neighbours_k(); i++) {
+		v = s->meta->idx[row[i]];
+		check_insertion(feasible[row[i]]);
+		feasible[row[i]] = false;
+	}
+	for (int id = 1; id <= p.n_customers; id++) {
 		v = s->meta->idx[id];
-		check_insertion();
+		check_insertion(feasible[id]);
 	}
 	for (int i = 0; i < s->n_routes; i++) {
 		v = depot_tail(s->routes[i]);
-		check_insertion();
+		check_insertion(tail_feasible[i]);
 	}
 #undef check_insertion
+	region_truncate(gc, gc_used);
 	return selected;
 }
 
@@ -681,21 +764,18 @@ solution_find_optimal_insertion(struct solution *s, struct customer *w,
 				double alpha, double beta)
 {
 	assert(is_ejected(w));
-	struct customer *v;
 	struct modification opt_modification =
 		modification_new(INSERT, nullptr, nullptr);
 	double opt_penalty = INFINITY;
 	for(int i = 0; i < s->n_routes; i++) {
-		for (int j = 1; j < s->routes[i]->size; j++) {
-			v = s->routes[i]->customers[j];
-			struct modification m = modification_new(INSERT, v, w);
-			double penalty = modification_delta(m, alpha, beta);
-			if (penalty < opt_penalty) {
-				if (penalty < EPS5)
-					return m;
-				opt_modification = m;
-				opt_penalty = penalty;
-			}
+		double penalty;
+		struct modification m = route_find_optimal_insertion(
+			s->routes[i], w, alpha, beta, &penalty);
+		if (penalty < opt_penalty) {
+			if (penalty < EPS5)
+				return m;
+			opt_modification = m;
+			opt_penalty = penalty;
 		}
 	}
 	return opt_modification;
@@ -712,16 +792,11 @@ solution_eliminate_random_route(struct solution *s)
 {
 	int route_idx = randint(0, s->n_routes - 1);
 	struct route *r = s->routes[route_idx];
-	SWAP(s->routes[route_idx], s->routes[s->n_routes - 1]);
-	--s->n_routes;
 	for (int i = 1; i + 1 < r->size; i++) {
 		struct customer *c = r->customers[i];
 		c->route = nullptr;
 		c->idx = -1;
-		rlist_add_tail_entry(&s->ejection_pool, c, in_eject);
+		solution_ejection_pool_push(s, c);
 	}
-	customer_delete(depot_head(r));
-	customer_delete(depot_tail(r));
-	r->size = 0;
-	route_delete(r);
+	route_journal_remove(&s->journal, s->routes, &s->n_routes, route_idx);
 }
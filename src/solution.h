@@ -3,6 +3,8 @@
 
 #include "small/rlist.h"
 
+#include "small_extra/rlist_persistent.h"
+
 #include "customer.h"
 #include "modification.h"
 #include "random_utils.h"
@@ -18,13 +20,54 @@ struct solution {
     	struct customer *w;
     	struct solution_meta *meta;
 	struct rlist ejection_pool;
+	/** Undo log of the routes, see solution_savepoint() */
+	struct route_journal journal;
+	/** Undo log of ejection_pool */
+	rlist_persistent_history ejection_history;
+	/** State of the open savepoints that is not in the undo logs */
+	struct {
+		struct customer *w;
+		rlist_persistent_svp ejection_pool;
+	} savepoints[ROUTE_JOURNAL_MAX_DEPTH];
 	int n_routes;
 	struct route *routes[0];
 };
 
+/**
+ * Build the neighbour lists used by the searches, long enough for
+ * \a n_near neighbours. Does nothing if they are already.
+ */
+void
+solution_global_init(int n_near);
+
+/**
+ * Rank the neighbour lists of the customers by a time-window aware
+ * relatedness instead of the distance. Call before the first search.
+ */
+void
+solution_set_tw_neighbours(bool enable);
+
+/**
+ * Visitor of solution_modification_neighbourhood(). The modification
+ * is only valid during the call. Returns true to stop the enumeration.
+ */
+typedef bool
+(*modification_visitor_f)(struct modification *m, void *arg);
+
+/**
+ * Enumerate the modifications that move the customers of \a r towards
+ * their \a n_near nearest neighbours and call \a visit for each one.
+ */
 void
-solution_global_init();
+solution_modification_neighbourhood(struct solution *s, struct route *r,
+				    int n_near, modification_visitor_f visit,
+				    void *visit_arg);
 
+/**
+ * Fiber version of solution_modification_neighbourhood(). Arguments:
+ * solution, route, n_near and a modification the fiber stores each
+ * visited modification in before yielding. Cancel the fiber to stop.
+ */
 int
 solution_modification_neighbourhood_f(va_list ap);
 
@@ -49,12 +92,41 @@ solution_move(struct solution *dst, struct solution *src);
 void
 solution_delete(struct solution *s);
 
+/**
+ * Open a savepoint. Until it is closed the solution records just
+ * enough to restore its current state: the routes modified by
+ * modification_apply() or removed by solution_eliminate_random_route(),
+ * the changes of the ejection pool and w. Savepoints can be nested.
+ */
+void
+solution_savepoint(struct solution *s);
+
+/** Restore the state of the newest savepoint and close it */
+void
+solution_rollback_to_savepoint(struct solution *s);
+
+/** Close the newest savepoint keeping all the changes */
+void
+solution_release_savepoint(struct solution *s);
+
+/** Add \a c to the tail of the ejection pool */
+void
+solution_ejection_pool_push(struct solution *s, struct customer *c);
+
+/** Remove the last customer from the ejection pool and return it */
+struct customer *
+solution_ejection_pool_pop(struct solution *s);
+
 double
 solution_penalty(struct solution *s, double alpha, double beta);
 
 bool
 solution_feasible(struct solution *s);
 
+/** See route_feasible_exact() */
+bool
+solution_feasible_exact(struct solution *s);
+
 //int
 //split_by_feasibility(struct solution *s);
 
@@ -64,9 +136,6 @@ solution_print(struct solution *s);
 double
 solution_routing_cost(struct solution *s);
 
-void
-solution_print_incumbent_json(struct solution *s, long elapsed_ms);
-
 void ALWAYS_INLINE
 solution_check_routes(struct solution *s)
 {
@@ -81,9 +150,8 @@ void ALWAYS_INLINE
 solution_check_missed_customers(struct solution *s) {
 	(void)s;
 #ifndef NDEBUG
-	static bool used[MAX_N_CUSTOMERS + 1];
-	for (int i = 0; i <= p.n_customers; i++)
-		used[i] = false;
+	bool *used = (bool *)calloc(p.n_customers + 1, sizeof(used[0]));
+	assert(used != NULL);
 	int cnt = 0;
 	for (int i = 0; i < s->n_routes; i++) {
 		struct customer *c;
@@ -98,6 +166,7 @@ solution_check_missed_customers(struct solution *s) {
 		used[c->id] = true;
 	}
 	if (s->w && !used[s->w->id]) cnt++;
+	free(used);
 	assert(cnt == p.n_customers + 1);
 #endif
 }
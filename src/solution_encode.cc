@@ -1,15 +1,16 @@
 #include "solution_encode.h"
 
-#include <fstream>
-
-#include "dist.h"
+#include "outbuf.h"
+#include "problem.h"
 #include "utils.h"
 
+/** Reused by all the writers, so a solution costs no allocations */
+static struct outbuf solution_outbuf;
+
 void
 solution_encode(solution *s, const char *file)
 {
-	std::string file_string = std::string(file);
-	std::ofstream f(file_string);
+	struct outbuf *b = &solution_outbuf;
 	for (int i = 0; i < s->n_routes; i++) {
 		route *r = s->routes[i];
 		double t = -(double)INFINITY;
@@ -17,13 +18,38 @@ solution_encode(solution *s, const char *file)
 			customer *prev = r->customers[j];
 			customer *next = (j + 1 < r->size) ? r->customers[j + 1] : prev;
 			t = MAX(prev->e, t);
-			f << prev->id << " " << t;
+			outbuf_int(b, prev->id);
+			outbuf_char(b, ' ');
+			outbuf_double(b, t);
 			if (prev != depot_tail(s->routes[i])) {
-				f << " ";
-				t += prev->s + dist(prev, next);
+				outbuf_char(b, ' ');
+				t += prev->s + problem_customer_distance(prev, next);
 			}
 			prev = next;
 		}
-		f << "\n";
+		outbuf_char(b, '\n');
+	}
+	outbuf_write_file(b, file);
+}
+
+void
+solution_encode_binary(solution *s, const char *file)
+{
+	struct outbuf *b = &solution_outbuf;
+	struct solution_binary_header h;
+	memcpy(h.magic, SOLUTION_BINARY_MAGIC, sizeof(h.magic));
+	h.version = SOLUTION_BINARY_VERSION;
+	h.n_routes = s->n_routes;
+	outbuf_append(b, &h, sizeof(h));
+	for (int i = 0; i < s->n_routes; i++) {
+		route *r = s->routes[i];
+		/** Skip the depots at both ends */
+		uint32_t size = r->size - 2;
+		outbuf_append(b, &size, sizeof(size));
+		for (int j = 1; j < r->size - 1; j++) {
+			uint32_t id = r->customers[j]->id;
+			outbuf_append(b, &id, sizeof(id));
+		}
 	}
+	outbuf_write_file(b, file);
 }
@@ -7,9 +7,32 @@
 extern "C" {
 #endif /* defined(__cplusplus) */
 
+#define SOLUTION_BINARY_MAGIC "VRPTWRTS"
+#define SOLUTION_BINARY_VERSION 1
+
+/**
+ * Header of the binary route format. It is followed by the routes,
+ * each one is its uint32_t number of customers and their uint32_t ids
+ * in the visiting order, the depots omitted. All the fields are in
+ * the host byte order.
+ */
+struct solution_binary_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t n_routes;
+};
+
+/**
+ * Write the routes to \a file as text, one route per line of the ids
+ * and the service start times of its visits, the depots included.
+ */
 void
 solution_encode(struct solution *s, const char *file);
 
+/** Write the routes to \a file in the binary route format */
+void
+solution_encode_binary(struct solution *s, const char *file);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
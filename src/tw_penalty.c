@@ -1,6 +1,9 @@
 #include "tw_penalty.h"
 
 #include "assert.h"
+#include <string.h>
+
+#include "small/region.h"
 
 #include "dist.h"
 #include "modification.h"
@@ -11,89 +14,93 @@
 #include "utils.h"
 #include "penalty_inline.h"
 
-void
-tw_penalty_init(struct route *r)
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Recompute the prefix values starting at \a start_idx. The customers
+ * from \a check_idx on have the same predecessors as when their values
+ * were computed, so once `a` of one of them is unchanged the rest of the
+ * prefix only has its penalty shifted by a constant.
+ */
+static ALWAYS_INLINE void
+tw_penalty_update_forward_from(struct route *r, int start_idx, int check_idx)
 {
-	double a_quote;
-	struct customer *prev = depot_head(r);
-	prev->a = prev->e;
-	prev->tw_pf = 0.;
-	prev->idx = 0;
-	for (int i = 1; i < r->size; i++) {
-		struct customer *next = r->customers[i];
-		a_quote = prev->a + prev->s + dist(prev, next);
-		next->a = MIN(MAX(a_quote, next->e), next->l);
-		next->tw_pf =
-			prev->tw_pf + MAX(0., a_quote - next->l);
-		next->idx = prev->idx + 1;
-		prev = next;
+	if (start_idx == 0) {
+		r->tw[0].a = r->tw[0].e;
+		r->tw[0].tw_pf = 0.;
+		start_idx = 1;
 	}
-	double z_quote;
-	struct customer *next = depot_tail(r);
-	next->z = p.depot->l;
-	next->tw_sf = 0.;
-	for (int i = r->size - 2; i >= 0; i--) {
-		prev = r->customers[i];
-		z_quote = next->z - prev->s - dist(prev, next);
-		prev->z = MIN(MAX(z_quote, prev->e), prev->l);
-		prev->tw_sf =
-			next->tw_sf + MAX(0., prev->e - z_quote);
-		next = prev;
+	struct route_tw_data *prev = &r->tw[start_idx - 1];
+	for (int i = start_idx; i < r->size; i++) {
+		struct route_tw_data *cur = &r->tw[i];
+		double a_quote = prev->a + prev->s + dist_id(prev->id, cur->id);
+		double a = MIN(MAX(a_quote, cur->e), cur->l);
+		double tw_pf = prev->tw_pf + MAX(0., a_quote - cur->l);
+		if (i >= check_idx && a == cur->a) {
+			double offset = tw_pf - cur->tw_pf;
+			cur->tw_pf = tw_pf;
+			if (offset != 0.) {
+				for (int j = i + 1; j < r->size; j++)
+					r->tw[j].tw_pf += offset;
+			}
+			return;
+		}
+		cur->a = a;
+		cur->tw_pf = tw_pf;
+		prev = cur;
 	}
 }
 
-void
-tw_penalty_update_forward(struct customer *start)
+/** Same as tw_penalty_update_forward_from() for the suffix values */
+static ALWAYS_INLINE void
+tw_penalty_update_backward_from(struct route *r, int start_idx, int check_idx)
 {
-	if (start == NULL)
-		return;
-	struct route *r = start->route;
-	assert(r != NULL);
-
-	if (start == depot_head(r)) {
-		start->a = start->e;
-		start->tw_pf = 0.;
-		start->idx = 0;
-		start = route_next(start);
-		if (start->idx >= r->size)
-			return;
+	if (start_idx == r->size - 1) {
+		r->tw[start_idx].z = p.depot->l;
+		r->tw[start_idx].tw_sf = 0.;
+		start_idx--;
 	}
-
-	struct customer *prev = route_prev(start);
-	for (int i = start->idx; i < r->size; i++) {
-		struct customer *cur = r->customers[i];
-		double a_quote = prev->a + prev->s + dist(prev, cur);
-		cur->a = MIN(MAX(a_quote, cur->e), cur->l);
-		cur->tw_pf = prev->tw_pf + MAX(0., a_quote - cur->l);
-		cur->idx = prev->idx + 1;
-		prev = cur;
+	struct route_tw_data *next = &r->tw[start_idx + 1];
+	for (int i = start_idx; i >= 0; i--) {
+		struct route_tw_data *cur = &r->tw[i];
+		double z_quote = next->z - cur->s - dist_id(cur->id, next->id);
+		double z = MIN(MAX(z_quote, cur->e), cur->l);
+		double tw_sf = next->tw_sf + MAX(0., cur->e - z_quote);
+		if (i <= check_idx && z == cur->z) {
+			double offset = tw_sf - cur->tw_sf;
+			cur->tw_sf = tw_sf;
+			if (offset != 0.) {
+				for (int j = i - 1; j >= 0; j--)
+					r->tw[j].tw_sf += offset;
+			}
+			return;
+		}
+		cur->z = z;
+		cur->tw_sf = tw_sf;
+		next = cur;
 	}
 }
 
 void
-tw_penalty_update_backward(struct customer *start)
+tw_penalty_init(struct route *r)
 {
-	if (start == NULL)
-		return;
-	struct route *r = start->route;
-	assert(r != NULL);
-
-	if (start == depot_tail(r)) {
-		start->z = p.depot->l;
-		start->tw_sf = 0.;
-		start = route_prev(start);
-		if (start->idx < 0)
-			return;
-	}
+	tw_penalty_update_forward_from(r, 0, r->size);
+	tw_penalty_update_backward_from(r, r->size - 1, -1);
+}
 
-	struct customer *next = route_next(start);
-	for (int i = start->idx; i >= 0; i--) {
-		struct customer *cur = r->customers[i];
-		double z_quote = next->z - cur->s - dist(cur, next);
-		cur->z = MIN(MAX(z_quote, cur->e), cur->l);
-		cur->tw_sf = next->tw_sf + MAX(0., cur->e - z_quote);
-		next = cur;
-	}
+void
+tw_penalty_update(struct customer *forward_start,
+		  struct customer *backward_start)
+{
+	struct route *r = forward_start->route;
+	assert(r != NULL && backward_start->route == r);
+	int first = forward_start->idx;
+	int last = backward_start->idx;
+	assert(first <= last + 1);
+	tw_penalty_update_forward_from(r, first, last + 1);
+	tw_penalty_update_backward_from(r, last, first - 1);
 }
 
 double
@@ -114,6 +121,321 @@ tw_penalty_get_insert_delta(struct customer *v, struct customer *w)
 	return tw_penalty_get_insert_delta_inline(v, w);
 }
 
+void
+tw_penalty_eject_into(struct route *r, int idx, struct route_tw_data *tw)
+{
+	assert(idx > 0 && idx < r->size - 1);
+	memcpy(tw, r->tw, sizeof(tw[0]) * idx);
+	memcpy(&tw[idx], &r->tw[idx + 1], sizeof(tw[0]) * (r->size - idx - 1));
+	/** Only the penalty data of the route is needed */
+	struct route ejected;
+	ejected.tw = tw;
+	ejected.size = r->size - 1;
+	tw_penalty_update_forward_from(&ejected, idx, idx);
+	tw_penalty_update_backward_from(&ejected, idx - 1, idx - 1);
+}
+
+static ALWAYS_INLINE void
+tw_segment_init(struct tw_segment *seg, struct route_tw_data *c)
+{
+	seg->duration = c->s;
+	seg->time_warp = 0.;
+	seg->earliest = c->e;
+	seg->latest = c->l;
+	seg->first_id = c->id;
+	seg->last_id = c->id;
+}
+
+static ALWAYS_INLINE void
+tw_segment_concat(struct tw_segment *res, struct tw_segment *first,
+		  struct tw_segment *second)
+{
+	double delta = first->duration - first->time_warp +
+		dist_id(first->last_id, second->first_id);
+	double delta_wait = MAX(0., second->earliest - delta - first->latest);
+	double delta_warp = MAX(0., first->earliest + delta - second->latest);
+	res->duration = first->duration + second->duration +
+		dist_id(first->last_id, second->first_id) + delta_wait;
+	res->time_warp = first->time_warp + second->time_warp + delta_warp;
+	res->earliest = MAX(second->earliest - delta, first->earliest) -
+		delta_wait;
+	res->latest = MIN(second->latest - delta, first->latest) + delta_warp;
+	res->first_id = first->first_id;
+	res->last_id = second->last_id;
+}
+
+void
+tw_segment_table_create(struct tw_segment_table *t, struct route *r,
+			struct region *gc)
+{
+	t->r = r;
+	t->n_levels = 0;
+	for (int len = 1; len <= r->size; len *= 2) {
+		assert(t->n_levels < TW_SEGMENT_TABLE_MAX_LEVELS);
+		int n = r->size - len + 1;
+		struct tw_segment *level =
+			xregion_alloc_array(gc, struct tw_segment, n);
+		if (len == 1) {
+			for (int i = 0; i < n; i++)
+				tw_segment_init(&level[i], &r->tw[i]);
+		} else {
+			struct tw_segment *prev = t->levels[t->n_levels - 1];
+			for (int i = 0; i < n; i++)
+				tw_segment_concat(&level[i], &prev[i],
+						  &prev[i + len / 2]);
+		}
+		t->levels[t->n_levels++] = level;
+	}
+}
+
+/**
+ * Forward evaluation of a reordered route: the departure time from
+ * the last visited customer and the penalty so far.
+ */
+struct tw_walk {
+	double departure;
+	double penalty;
+	int id;
+};
+
+/** Start with the prefix of the route ending at \a c */
+static ALWAYS_INLINE void
+tw_walk_start(struct tw_walk *walk, struct route_tw_data *c)
+{
+	walk->departure = c->a + c->s;
+	walk->penalty = c->tw_pf;
+	walk->id = c->id;
+}
+
+static ALWAYS_INLINE void
+tw_walk_segment(struct tw_walk *walk, struct tw_segment *seg)
+{
+	double a_quote = walk->departure + dist_id(walk->id, seg->first_id);
+	walk->penalty += MAX(0., a_quote - seg->latest) + seg->time_warp;
+	walk->departure = MIN(MAX(a_quote, seg->earliest), seg->latest) +
+		seg->duration - seg->time_warp;
+	walk->id = seg->last_id;
+}
+
+static ALWAYS_INLINE void
+tw_walk_customer(struct tw_walk *walk, struct route_tw_data *c)
+{
+	double a_quote = walk->departure + dist_id(walk->id, c->id);
+	walk->penalty += MAX(0., a_quote - c->l);
+	walk->departure = MIN(MAX(a_quote, c->e), c->l) + c->s;
+	walk->id = c->id;
+}
+
+/** Visit the customers [from, to] of the route in their order */
+static ALWAYS_INLINE void
+tw_walk_range(struct tw_walk *walk, struct tw_segment_table *t,
+	      struct route *r, int from, int to)
+{
+	if (t == NULL) {
+		for (int i = from; i <= to; i++)
+			tw_walk_customer(walk, &r->tw[i]);
+		return;
+	}
+	assert(t->r == r);
+	while (from <= to) {
+		int k = 31 - __builtin_clz(to - from + 1);
+		tw_walk_segment(walk, &t->levels[k][from]);
+		from += 1 << k;
+	}
+}
+
+/** Join the suffix of the route starting at \a c, return the penalty */
+static ALWAYS_INLINE double
+tw_walk_finish(struct tw_walk *walk, struct route_tw_data *c)
+{
+	double a_quote = walk->departure + dist_id(walk->id, c->id);
+	return walk->penalty + MAX(0., a_quote - c->z) + c->tw_sf;
+}
+
+double
+tw_penalty_intra_route_out_relocate_delta(struct tw_segment_table *t,
+					  struct customer *v,
+					  struct customer *w)
+{
+	assert(v->route == w->route && v != w);
+	assert(v->idx > 0 && w->idx > 0 && w->idx < w->route->size - 1);
+	struct route *r = v->route;
+	struct tw_walk walk;
+	if (w->idx < v->idx) {
+		tw_walk_start(&walk, &r->tw[w->idx - 1]);
+		tw_walk_range(&walk, t, r, w->idx + 1, v->idx - 1);
+		tw_walk_customer(&walk, &r->tw[w->idx]);
+	} else {
+		tw_walk_start(&walk, &r->tw[v->idx - 1]);
+		tw_walk_customer(&walk, &r->tw[w->idx]);
+		tw_walk_range(&walk, t, r, v->idx, w->idx - 1);
+	}
+	int next = MAX(v->idx, w->idx + 1);
+	return tw_walk_finish(&walk, &r->tw[next]) -
+	       tw_penalty_get_penalty_inline(r);
+}
+
+double
+tw_penalty_intra_route_exchange_delta(struct tw_segment_table *t,
+				      struct customer *v, struct customer *w)
+{
+	assert(v->route == w->route);
+	if (unlikely(v == w))
+		return 0.;
+	if (v->idx > w->idx)
+		SWAP(v, w);
+	assert(v->idx > 0 && w->idx < w->route->size - 1);
+	struct route *r = v->route;
+	struct tw_walk walk;
+	tw_walk_start(&walk, &r->tw[v->idx - 1]);
+	tw_walk_customer(&walk, &r->tw[w->idx]);
+	tw_walk_range(&walk, t, r, v->idx + 1, w->idx - 1);
+	tw_walk_customer(&walk, &r->tw[v->idx]);
+	return tw_walk_finish(&walk, &r->tw[w->idx + 1]) -
+	       tw_penalty_get_penalty_inline(r);
+}
+
+/*
+ * The vector kernels below evaluate tw_penalty_insert_between_inline()
+ * for several consecutive positions at once. They gather the fields of
+ * the route_tw_data records, which are 8 doubles apart, and perform the
+ * same operations in the same order. This file is built without
+ * -ffast-math, so they agree with the scalar functions of this file.
+ * The inline copies in the other files may still be reassociated by
+ * -Ofast and differ from them in the last bits.
+ */
+static_assert(sizeof(struct route_tw_data) == 8 * sizeof(double),
+	      "route_tw_data fields are gathered with a stride of 8 doubles");
+
+#if defined(__AVX512F__)
+
+/** Insertion penalties for the positions [i, i + 8) */
+static ALWAYS_INLINE void
+tw_penalty_insert_penalties_x8(struct route *r, int i, struct customer *w,
+			       double *penalty)
+{
+	const __m256i rec = _mm256_setr_epi32(0, 8, 16, 24, 32, 40, 48, 56);
+	const __m256i rec_id = _mm256_slli_epi32(rec, 1);
+	struct route_tw_data *prev = &r->tw[i - 1];
+	struct route_tw_data *next = &r->tw[i];
+	__m512d prev_a = _mm512_i32gather_pd(rec, &prev->a, 8);
+	__m512d prev_s = _mm512_i32gather_pd(rec, &prev->s, 8);
+	__m512d prev_pf = _mm512_i32gather_pd(rec, &prev->tw_pf, 8);
+	__m512d next_z = _mm512_i32gather_pd(rec, &next->z, 8);
+	__m512d next_sf = _mm512_i32gather_pd(rec, &next->tw_sf, 8);
+	__m256i prev_id = _mm256_i32gather_epi32(&prev->id, rec_id, 4);
+	__m256i next_id = _mm256_i32gather_epi32(&next->id, rec_id, 4);
+
+	__m256i stride = _mm256_set1_epi32(p.distance_matrix_stride);
+	__m256i w_id = _mm256_set1_epi32(w->id);
+	__m256i prev_w = _mm256_add_epi32(_mm256_mullo_epi32(prev_id, stride),
+					  w_id);
+	__m256i w_next = _mm256_add_epi32(_mm256_mullo_epi32(w_id, stride),
+					  next_id);
+#if DISTANCE_MATRIX_FLOAT
+	__m512d dist_prev_w = _mm512_cvtps_pd(
+		_mm256_i32gather_ps(p.distance_matrix, prev_w, 4));
+	__m512d dist_w_next = _mm512_cvtps_pd(
+		_mm256_i32gather_ps(p.distance_matrix, w_next, 4));
+#else
+	__m512d dist_prev_w = _mm512_i32gather_pd(prev_w, p.distance_matrix, 8);
+	__m512d dist_w_next = _mm512_i32gather_pd(w_next, p.distance_matrix, 8);
+#endif
+
+	__m512d zero = _mm512_setzero_pd();
+	__m512d w_e = _mm512_set1_pd(w->e);
+	__m512d w_l = _mm512_set1_pd(w->l);
+	__m512d w_s = _mm512_set1_pd(w->s);
+	__m512d p_tw = _mm512_add_pd(prev_pf, next_sf);
+	__m512d a_quote_w = _mm512_add_pd(_mm512_add_pd(prev_a, prev_s),
+					  dist_prev_w);
+	__m512d z_quote_w = _mm512_sub_pd(_mm512_sub_pd(next_z, w_s),
+					  dist_w_next);
+	p_tw = _mm512_add_pd(p_tw, _mm512_max_pd(zero,
+		_mm512_sub_pd(a_quote_w, w_l)));
+	p_tw = _mm512_add_pd(p_tw, _mm512_max_pd(zero,
+		_mm512_sub_pd(w_e, z_quote_w)));
+	__m512d a_w = _mm512_min_pd(_mm512_max_pd(a_quote_w, w_e), w_l);
+	__m512d z_w = _mm512_min_pd(_mm512_max_pd(z_quote_w, w_e), w_l);
+	p_tw = _mm512_add_pd(p_tw, _mm512_max_pd(zero, _mm512_sub_pd(a_w, z_w)));
+	_mm512_storeu_pd(&penalty[i], p_tw);
+}
+
+#define TW_PENALTY_INSERT_WIDTH 8
+#define tw_penalty_insert_penalties_vec tw_penalty_insert_penalties_x8
+
+#elif defined(__AVX2__)
+
+/** Insertion penalties for the positions [i, i + 4) */
+static ALWAYS_INLINE void
+tw_penalty_insert_penalties_x4(struct route *r, int i, struct customer *w,
+			       double *penalty)
+{
+	const __m128i rec = _mm_setr_epi32(0, 8, 16, 24);
+	const __m128i rec_id = _mm_slli_epi32(rec, 1);
+	struct route_tw_data *prev = &r->tw[i - 1];
+	struct route_tw_data *next = &r->tw[i];
+	__m256d prev_a = _mm256_i32gather_pd(&prev->a, rec, 8);
+	__m256d prev_s = _mm256_i32gather_pd(&prev->s, rec, 8);
+	__m256d prev_pf = _mm256_i32gather_pd(&prev->tw_pf, rec, 8);
+	__m256d next_z = _mm256_i32gather_pd(&next->z, rec, 8);
+	__m256d next_sf = _mm256_i32gather_pd(&next->tw_sf, rec, 8);
+	__m128i prev_id = _mm_i32gather_epi32(&prev->id, rec_id, 4);
+	__m128i next_id = _mm_i32gather_epi32(&next->id, rec_id, 4);
+
+	__m128i stride = _mm_set1_epi32(p.distance_matrix_stride);
+	__m128i w_id = _mm_set1_epi32(w->id);
+	__m128i prev_w = _mm_add_epi32(_mm_mullo_epi32(prev_id, stride), w_id);
+	__m128i w_next = _mm_add_epi32(_mm_mullo_epi32(w_id, stride), next_id);
+#if DISTANCE_MATRIX_FLOAT
+	__m256d dist_prev_w = _mm256_cvtps_pd(
+		_mm_i32gather_ps(p.distance_matrix, prev_w, 4));
+	__m256d dist_w_next = _mm256_cvtps_pd(
+		_mm_i32gather_ps(p.distance_matrix, w_next, 4));
+#else
+	__m256d dist_prev_w = _mm256_i32gather_pd(p.distance_matrix, prev_w, 8);
+	__m256d dist_w_next = _mm256_i32gather_pd(p.distance_matrix, w_next, 8);
+#endif
+
+	__m256d zero = _mm256_setzero_pd();
+	__m256d w_e = _mm256_set1_pd(w->e);
+	__m256d w_l = _mm256_set1_pd(w->l);
+	__m256d w_s = _mm256_set1_pd(w->s);
+	__m256d p_tw = _mm256_add_pd(prev_pf, next_sf);
+	__m256d a_quote_w = _mm256_add_pd(_mm256_add_pd(prev_a, prev_s),
+					  dist_prev_w);
+	__m256d z_quote_w = _mm256_sub_pd(_mm256_sub_pd(next_z, w_s),
+					  dist_w_next);
+	p_tw = _mm256_add_pd(p_tw, _mm256_max_pd(zero,
+		_mm256_sub_pd(a_quote_w, w_l)));
+	p_tw = _mm256_add_pd(p_tw, _mm256_max_pd(zero,
+		_mm256_sub_pd(w_e, z_quote_w)));
+	__m256d a_w = _mm256_min_pd(_mm256_max_pd(a_quote_w, w_e), w_l);
+	__m256d z_w = _mm256_min_pd(_mm256_max_pd(z_quote_w, w_e), w_l);
+	p_tw = _mm256_add_pd(p_tw, _mm256_max_pd(zero, _mm256_sub_pd(a_w, z_w)));
+	_mm256_storeu_pd(&penalty[i], p_tw);
+}
+
+#define TW_PENALTY_INSERT_WIDTH 4
+#define tw_penalty_insert_penalties_vec tw_penalty_insert_penalties_x4
+
+#endif
+
+void
+tw_penalty_get_insert_penalties(struct route *r, struct customer *w,
+				double *penalty)
+{
+	int i = 1;
+#ifdef TW_PENALTY_INSERT_WIDTH
+	for (; i + TW_PENALTY_INSERT_WIDTH <= r->size;
+	     i += TW_PENALTY_INSERT_WIDTH)
+		tw_penalty_insert_penalties_vec(r, i, w, penalty);
+#endif
+	for (; i < r->size; i++)
+		penalty[i] = tw_penalty_insert_between_inline(&r->tw[i - 1],
+							      &r->tw[i], w);
+}
+
 double
 tw_penalty_get_replace_penalty(struct customer *v, struct customer *w)
 {
@@ -160,8 +482,7 @@ tw_penalty_out_relocate_penalty_delta_slow
 	(struct customer *v, struct customer *w)
 {
 	assert(v->route == w->route);
-	struct modification m = modification_new(OUT_RELOCATE, v, w);
-	return tw_penalty_modification_apply_straight_delta(m);
+	return tw_penalty_intra_route_out_relocate_delta(NULL, v, w);
 }
 
 double
@@ -186,8 +507,8 @@ tw_penalty_out_relocate_penalty_delta(struct customer *v, struct customer *w)
 double
 tw_penalty_exchange_penalty_delta_slow(struct customer *v, struct customer *w)
 {
-	struct modification m = modification_new(EXCHANGE, v, w);
-	return tw_penalty_modification_apply_straight_delta(m);
+	assert(v->route == w->route);
+	return tw_penalty_intra_route_exchange_delta(NULL, v, w);
 }
 
 double
@@ -226,7 +547,7 @@ tw_penalty_exchange_penalty_delta_lower_bound(struct customer *v,
 	a = seg[0]->a, a_quote;                     		\
 	for (int j = 1; j < 3; j++) {				\
 		a_quote = a + seg[j - 1]->s			\
-			+ dist(seg[j - 1], seg[j]);		\
+			+ dist_id(seg[j - 1]->id, seg[j]->id);	\
 		a = MIN(MAX(a_quote, seg[j]->e), seg[j]->l);	\
 		p_tw += MAX(0., a_quote - seg[j]->l);		\
 	}} while(0)
@@ -234,18 +555,20 @@ tw_penalty_exchange_penalty_delta_lower_bound(struct customer *v,
 		struct route *r = v->route;
 		if (v->idx > w->idx)
 			SWAP(v, w);
-		struct customer *v_minus = route_prev(v), *v_plus = route_next(v),
-			*w_minus = route_prev(w), *w_plus = route_next(w);
+		struct route_tw_data *v_tw = &r->tw[v->idx], *w_tw = &r->tw[w->idx],
+			*v_minus = v_tw - 1, *v_plus = v_tw + 1,
+			*w_minus = w_tw - 1, *w_plus = w_tw + 1;
 		double p_tw = v_minus->tw_pf;
-		struct customer *seg[3];
+		struct route_tw_data *seg[3];
 		double a = 0., a_quote = 0.;
 		if (likely(v->idx + 1 < w->idx)) {
-			upd_through_seg(v_minus, w, v_plus);
+			upd_through_seg(v_minus, w_tw, v_plus);
 			if (unlikely(fabs(a - v_plus->a) < EPS7)) {
 				p_tw += w_minus->tw_pf - v_plus->tw_pf;
-				upd_through_seg(w_minus, v, w_plus);
+				upd_through_seg(w_minus, v_tw, w_plus);
 				if (unlikely(fabs(a - w_plus->a) < EPS7)) {
-					p_tw += depot_tail(r)->tw_pf - w_plus->tw_pf;
+					p_tw += tw_penalty_get_penalty_inline(r) -
+						w_plus->tw_pf;
 					*exact = true;
 					return p_tw - tw_penalty_get_penalty(r);
 				}
@@ -253,9 +576,10 @@ tw_penalty_exchange_penalty_delta_lower_bound(struct customer *v,
 			*exact = false;
 			return p_tw - tw_penalty_get_penalty(r);
 		} else {
-			upd_through_seg(v_minus, w, v);
+			upd_through_seg(v_minus, w_tw, v_tw);
 			p_tw += w_plus->tw_sf;
-			double a_quote_w_plus = a + v->s + dist(v, w_plus);
+			double a_quote_w_plus = a + v_tw->s +
+				dist_id(v_tw->id, w_plus->id);
 			p_tw += MAX(0., a_quote_w_plus - w_plus->z);
 			*exact = true;
 			return p_tw - tw_penalty_get_penalty(r);
@@ -10,15 +10,10 @@
  * Wout Dullaert
  */
 
-#define tw_penalty_attr \
-    int idx;            \
-    double a;		\
-    double tw_pf;	\
-    double z;		\
-    double tw_sf
-
 struct customer;
 struct route;
+struct route_tw_data;
+struct region;
 
 #if defined(__cplusplus)
 extern "C" {
@@ -27,11 +22,16 @@ extern "C" {
 void
 tw_penalty_init(struct route *r);
 
+/**
+ * Update the penalty data of a route after a modification that placed
+ * new customers at the positions [\a forward_start, \a backward_start],
+ * or only linked the neighbours of an empty range, as after an ejection.
+ * The rest of the customers must have kept their own penalty data. The
+ * propagation stops as soon as the old values are reached again.
+ */
 void
-tw_penalty_update_forward(struct customer *start);
-
-void
-tw_penalty_update_backward(struct customer *start);
+tw_penalty_update(struct customer *forward_start,
+		  struct customer *backward_start);
 
 double
 tw_penalty_get_penalty(struct route *r);
@@ -42,6 +42,16 @@ tw_penalty_get_insert_penalty(struct customer *v, struct customer *w);
 double
 tw_penalty_get_insert_delta(struct customer *v, struct customer *w);
 
+/**
+ * tw_penalty_get_insert_penalty() of \a w for every position of \a r:
+ * penalty[i] is the penalty of inserting \a w before the customer at
+ * position i, for i in [1, r->size). Vectorized with AVX-512 or AVX2
+ * when the target supports them.
+ */
+void
+tw_penalty_get_insert_penalties(struct route *r, struct customer *w,
+				double *penalty);
+
 double
 tw_penalty_get_replace_penalty(struct customer *v, struct customer *w);
 
@@ -54,6 +64,68 @@ tw_penalty_get_eject_penalty(struct customer *v);
 double
 tw_penalty_get_eject_delta(struct customer *v);
 
+/**
+ * Fill \a tw with the time-window data \a r would have without the
+ * customer at position \a idx, as if it were ejected. \a tw must have
+ * room for r->size - 1 positions.
+ */
+void
+tw_penalty_eject_into(struct route *r, int idx, struct route_tw_data *tw);
+
+/**
+ * Summary of a sequence of consecutive customers of a route, as in the
+ * time-warp concatenation of Vidal et al. "A hybrid genetic algorithm with
+ * adaptive diversity management for a large class of vehicle routing
+ * problems with time-windows". The penalty of a route is the time warp of
+ * the concatenation of its customers.
+ */
+struct tw_segment {
+	/** Travel, service and waiting time, time warp excluded */
+	double duration;
+	/** Penalty inside the sequence */
+	double time_warp;
+	/** Earliest and latest start at the first customer */
+	double earliest;
+	double latest;
+	int first_id;
+	int last_id;
+};
+
+/** Enough levels for a route of any int size */
+enum { TW_SEGMENT_TABLE_MAX_LEVELS = 31 };
+
+/**
+ * Summaries of all subsequences of a route whose length is a power of two:
+ * levels[k][i] covers the customers [i, i + 2^k). Any subsequence is then
+ * evaluated with O(log n) concatenations. The table is a snapshot, it must
+ * be recreated after the route is modified.
+ */
+struct tw_segment_table {
+	struct route *r;
+	int n_levels;
+	struct tw_segment *levels[TW_SEGMENT_TABLE_MAX_LEVELS];
+};
+
+/** Build the segment table of \a r, allocating it on \a gc */
+void
+tw_segment_table_create(struct tw_segment_table *t, struct route *r,
+			struct region *gc);
+
+/**
+ * Exact penalty delta of an intra-route out-relocate (\a w is moved
+ * right before \a v) and exchange. \a t is the segment table of the route
+ * of \a v and \a w, or NULL to walk the moved subsequence customer by
+ * customer.
+ */
+double
+tw_penalty_intra_route_out_relocate_delta(struct tw_segment_table *t,
+					  struct customer *v,
+					  struct customer *w);
+
+double
+tw_penalty_intra_route_exchange_delta(struct tw_segment_table *t,
+				      struct customer *v, struct customer *w);
+
 #ifdef TW_PENALTY_TEST
 #include "modification.h"
 
@@ -1,5 +1,6 @@
 #include "unit.h"
 
+#include "core/memory.h"
 #include "core/random.h"
 
 #define C_PENALTY_TEST
@@ -26,6 +27,8 @@ int
 main(void)
 {
 	vtab = c_penalty_vtab;
+	memory_init();
+	pools_init();
 	random_init();
 	random_insertions(100);
 	random_ejections(100);
@@ -33,5 +36,7 @@ main(void)
 	random_two_opts(100);
 	random_out_relocations(100);
 	random_inter_route_exchanges(100);
+	pools_free();
+	memory_free();
 	return 0;
 }
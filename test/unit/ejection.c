@@ -7,6 +7,9 @@
 #define MAX_N_CUSTOMERS_TEST 10
 
 struct customer *cs[MAX_N_CUSTOMERS_TEST + 2];
+/** The scratch of feasible_ejections() for the routes of cs */
+static struct customer *
+scratch[FEASIBLE_EJECTIONS_SCRATCH_SIZE(MAX_N_CUSTOMERS_TEST + 2)];
 
 #define randint (int)pseudo_random_in_range
 
@@ -87,10 +90,49 @@ iterate_over_subsets_f(va_list ap)
 	}
 }
 
+/** The ejections visited so far with the p_best set for each one */
+struct ejections_record {
+	int n;
+	int64_t p_best[MAX_N_CUSTOMERS_TEST * 25];
+	int size[MAX_N_CUSTOMERS_TEST * 25];
+	int ids[MAX_N_CUSTOMERS_TEST * 25][MAX_N_CUSTOMERS_TEST];
+	/** The enumerator state the record is taken from */
+	struct customer **e;
+	int *e_size;
+	int64_t *p_best_ptr;
+};
+
+static bool
+ejections_record_visit(void *arg)
+{
+	struct ejections_record *r = arg;
+	assert(r->n < (int)lengthof(r->size));
+	r->p_best[r->n] = *r->p_best_ptr;
+	r->size[r->n] = *r->e_size;
+	for (int i = 0; i < *r->e_size; i++)
+		r->ids[r->n][i] = r->e[i]->id;
+	r->n++;
+	return false;
+}
+
+static bool
+ejections_record_equal(struct ejections_record *a, struct ejections_record *b)
+{
+	if (a->n != b->n)
+		return false;
+	for (int i = 0; i < a->n; i++) {
+		if (a->p_best[i] != b->p_best[i] || a->size[i] != b->size[i] ||
+		    memcmp(a->ids[i], b->ids[i], sizeof(int) * a->size[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
 void
 ejections_random_route(int n_tests)
 {
 	memory_init();
+	pools_init();
 	fiber_init(fiber_c_invoke);
 
 	int64_t ps[MAX_N_CUSTOMERS_TEST + 1];
@@ -114,14 +156,19 @@ ejections_random_route(int n_tests)
 			p_best_exp = INT64_MAX;
 		struct customer *ejection_act[MAX_N_CUSTOMERS_TEST];
 		int ejection_act_size = 0;
+		static struct ejections_record fiber_record, callback_record;
+		fiber_record.n = 0;
+		fiber_record.e = ejection_act;
+		fiber_record.e_size = &ejection_act_size;
+		fiber_record.p_best_ptr = &p_best_act;
 		RLIST_HEAD(ejection_idx_exp);
 
 		struct fiber *f1 = fiber_new(iterate_over_subsets_f),
 			*f2 = fiber_new(feasible_ejections_f);
 
 		fiber_start(f1, p.n_customers, 5, &ejection_idx_exp);
-		fiber_start(f2, route, 5, &ps[0], ejection_act, &ejection_act_size,
-			    &p_best_act);
+		fiber_start(f2, route, NULL, 0, 5, &ps[0], scratch,
+			    ejection_act, &ejection_act_size, &p_best_act);
 
 		while(!fiber_is_dead(f1)) {
 			struct route *route_exp = route_dup(route);
@@ -145,13 +192,90 @@ ejections_random_route(int n_tests)
 			route_delete(route_exp);
 			fiber_call(f1);
 		}
-		while (!fiber_is_dead(f2))
+		while (!fiber_is_dead(f2)) {
+			ejections_record_visit(&fiber_record);
 			fiber_call(f2);
+		}
+		/** The iterative enumerator visits the same ejections */
+		int64_t p_best_callback = INT64_MAX;
+		struct customer *ejection_callback[MAX_N_CUSTOMERS_TEST];
+		int ejection_callback_size = 0;
+		callback_record.n = 0;
+		callback_record.e = ejection_callback;
+		callback_record.e_size = &ejection_callback_size;
+		callback_record.p_best_ptr = &p_best_callback;
+		feasible_ejections(route, 5, &ps[0], scratch, ejection_callback,
+				   &ejection_callback_size, &p_best_callback,
+				   ejections_record_visit, &callback_record);
+		assert(ejections_record_equal(&fiber_record, &callback_record));
+		assert(p_best_callback == p_best_act);
 		fprintf(stderr, "%lld %lld %d\n",
 			(long long)p_best_act, (long long)p_best_exp, ejection_act_size);
 		fflush(stderr);
 		assert(p_best_act == p_best_exp);
 	}
+	pools_free();
+	memory_free();
+}
+
+/**
+ * The ejections of a virtual insertion are the ones of the route with
+ * the customer inserted.
+ */
+void
+ejections_virtual_insertion(int n_tests)
+{
+	memory_init();
+	pools_init();
+
+	int64_t ps[MAX_N_CUSTOMERS_TEST + 1];
+
+	for (int i = 0; i < n_tests; i++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+
+		for (int j = 0; j <= MAX_N_CUSTOMERS_TEST; j++)
+			ps[j] = randint(1, 5);
+
+		struct route *route = route_new();
+		struct customer *c;
+		int n = 0;
+		rlist_foreach_entry(c, &p.customers, in_route) {
+			if (c->id == 0) continue;
+			cs[n++] = c;
+		}
+		struct customer *w = cs[--n];
+		route_init(route, &cs[0], n);
+		int idx = randint(1, route->size - 1);
+		int k_max = randint(1, 5);
+
+		static struct ejections_record virtual_record, inserted_record;
+		struct customer *ejection[MAX_N_CUSTOMERS_TEST];
+		int ejection_size = 0;
+		int64_t p_best = INT64_MAX;
+		virtual_record.n = 0;
+		virtual_record.e = ejection;
+		virtual_record.e_size = &ejection_size;
+		virtual_record.p_best_ptr = &p_best;
+		feasible_ejections_insert(route, w, idx, k_max, &ps[0],
+					  scratch, ejection, &ejection_size,
+					  &p_best,
+					  ejections_record_visit,
+					  &virtual_record);
+
+		struct route *inserted = route_dup(route);
+		modification_apply(modification_new(
+			INSERT, inserted->customers[idx], w));
+		p_best = INT64_MAX;
+		inserted_record = virtual_record;
+		inserted_record.n = 0;
+		feasible_ejections(inserted, k_max, &ps[0], scratch,
+				   ejection, &ejection_size, &p_best,
+				   ejections_record_visit, &inserted_record);
+		assert(ejections_record_equal(&virtual_record,
+					      &inserted_record));
+		route_delete(inserted);
+	}
+	pools_free();
 	memory_free();
 }
 
@@ -160,5 +284,6 @@ main(void)
 {
 	random_init();
 	ejections_random_route(100);
+	ejections_virtual_insertion(1000);
 	return 0;
 }
@@ -65,4 +65,5 @@ generate_random_problem(int max_n_customers)
 		c->id = i + 1;
 		rlist_add_tail_entry(&p.customers, c, in_route);
 	}
+	problem_init_distance_matrix();
 }
@@ -2,6 +2,7 @@
 #define EAMA_ROUTES_MINIMIZATION_HEURISTIC_GENERATORS_H
 
 #include "customer.h"
+#include "pools.h"
 #include "problem.h"
 #include "route.h"
 
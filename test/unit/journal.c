@@ -0,0 +1,154 @@
+#include "unit.h"
+
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "generators.h"
+
+#define MAX_N_CUSTOMERS_TEST 30
+#define N_ROUTES_TEST 3
+
+#define randint (int)pseudo_random_in_range
+
+struct routes_state {
+	int n_routes;
+	struct route *routes[N_ROUTES_TEST];
+	int size[N_ROUTES_TEST];
+	int ids[N_ROUTES_TEST][MAX_N_CUSTOMERS_TEST + 2];
+	double tw_penalty[N_ROUTES_TEST];
+	double c_penalty[N_ROUTES_TEST];
+};
+
+static struct route *routes[N_ROUTES_TEST];
+static int n_routes;
+
+static void
+routes_state_save(struct routes_state *st)
+{
+	st->n_routes = n_routes;
+	for (int i = 0; i < n_routes; i++) {
+		struct route *r = routes[i];
+		route_check(r);
+		st->routes[i] = r;
+		st->size[i] = r->size;
+		for (int j = 0; j < r->size; j++)
+			st->ids[i][j] = r->customers[j]->id;
+		st->tw_penalty[i] = tw_penalty_get_penalty(r);
+		st->c_penalty[i] = c_penalty_get_penalty(r);
+	}
+}
+
+static void
+routes_state_check(struct routes_state *st)
+{
+	fail_unless(st->n_routes == n_routes);
+	for (int i = 0; i < n_routes; i++) {
+		struct route *r = routes[i];
+		route_check(r);
+		fail_unless(st->routes[i] == r);
+		fail_unless(st->size[i] == r->size);
+		for (int j = 0; j < r->size; j++) {
+			fail_unless(st->ids[i][j] == r->customers[j]->id);
+			fail_unless(r->customers[j]->route == r);
+			fail_unless(r->customers[j]->idx == j);
+		}
+		fail_unless(st->tw_penalty[i] == tw_penalty_get_penalty(r));
+		fail_unless(st->c_penalty[i] == c_penalty_get_penalty(r));
+	}
+}
+
+static struct customer *
+random_routed_customer(void)
+{
+	struct route *r = routes[randint(0, n_routes - 1)];
+	return r->customers[randint(0, r->size - 1)];
+}
+
+static void
+apply_random_modifications(int n)
+{
+	for (int i = 0; i < n; i++) {
+		enum modification_type t = randint(TWO_OPT, EXCHANGE);
+		struct modification m = modification_new(t,
+			random_routed_customer(), random_routed_customer());
+		if (modification_applicable(m))
+			modification_apply(m);
+	}
+}
+
+static void
+journal_random_rollbacks(int n_tests)
+{
+	struct route_journal j;
+	route_journal_create(&j);
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		struct customer *cs[MAX_N_CUSTOMERS_TEST];
+		struct customer *c;
+		int n = 0;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		n_routes = MIN(N_ROUTES_TEST, n);
+		for (int i = 0; i < n_routes; i++) {
+			int from = n * i / n_routes;
+			int to = n * (i + 1) / n_routes;
+			routes[i] = route_new();
+			route_init(routes[i], &cs[from], to - from);
+			routes[i]->journal = &j;
+		}
+
+		struct routes_state before, inner;
+		routes_state_save(&before);
+		route_journal_savepoint(&j);
+		apply_random_modifications(randint(0, 10));
+		routes_state_save(&inner);
+
+		/* Roll back a nested savepoint */
+		route_journal_savepoint(&j);
+		apply_random_modifications(randint(0, 10));
+		route_journal_remove(&j, routes, &n_routes,
+				     randint(0, n_routes - 1));
+		apply_random_modifications(randint(0, 10));
+		route_journal_rollback(&j, routes, &n_routes);
+		routes_state_check(&inner);
+
+		/* Release a nested savepoint, then roll back the outer one */
+		route_journal_savepoint(&j);
+		apply_random_modifications(randint(0, 10));
+		route_journal_release(&j);
+		apply_random_modifications(randint(0, 10));
+		route_journal_rollback(&j, routes, &n_routes);
+		routes_state_check(&before);
+		fail_unless(j.size == 0);
+
+		/* Release everything */
+		route_journal_savepoint(&j);
+		route_journal_remove(&j, routes, &n_routes,
+				     randint(0, n_routes - 1));
+		apply_random_modifications(randint(0, 10));
+		route_journal_release(&j);
+		fail_unless(j.depth == 0 && j.size == 0);
+		for (int i = 0; i < n_routes; i++) {
+			route_check(routes[i]);
+			fail_unless(routes[i]->journal_depth == 0);
+			/* The customers belong to the problem */
+			customer_delete(depot_head(routes[i]));
+			customer_delete(depot_tail(routes[i]));
+			routes[i]->size = 0;
+			route_delete(routes[i]);
+		}
+	}
+	route_journal_destroy(&j);
+}
+
+int
+main(void)
+{
+	memory_init();
+	pools_init();
+	random_init();
+	journal_random_rollbacks(1000);
+	pools_free();
+	memory_free();
+	return 0;
+}
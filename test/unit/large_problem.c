@@ -0,0 +1,125 @@
+#include "unit.h"
+
+#include "core/fiber.h"
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "cli.h"
+#include "eama_solver.h"
+#include "neighbours.h"
+#include "pools.h"
+#include "problem_cache.h"
+#include "problem_decode.h"
+
+/** More customers than the solver used to support */
+#define N_CUSTOMERS_TEST 2500
+/** The time a route may take, so two routes are needed at least */
+#define ROUTE_DURATION_TEST 2300
+
+static char problem_path[] = "/tmp/large_problem_test.XXXXXX";
+static char solution_path[] = "/tmp/large_problem_solution.XXXXXX";
+
+static void
+make_temp(char *path)
+{
+	int fd = mkstemp(path);
+	fail_unless(fd >= 0);
+	close(fd);
+}
+
+/**
+ * All the customers are at the depot and take a unit of time each,
+ * the capacity is not binding.
+ */
+static void
+write_problem(void)
+{
+	FILE *f = fopen(problem_path, "w");
+	fail_unless(f != NULL);
+	fprintf(f, "large\n\nVEHICLE\nNUMBER     CAPACITY\n"
+		"  %d          %d\n\nCUSTOMER\nCUST NO.  XCOORD.    YCOORD."
+		"    DEMAND   READY TIME  DUE DATE   SERVICE TIME\n\n",
+		N_CUSTOMERS_TEST, N_CUSTOMERS_TEST);
+	fprintf(f, "%5d %5d %5d %5d %5d %5d %5d\n", 0, 50, 50, 0, 0,
+		ROUTE_DURATION_TEST, 0);
+	for (int i = 1; i <= N_CUSTOMERS_TEST; i++)
+		fprintf(f, "%5d %5d %5d %5d %5d %5d %5d\n", i, 50, 50, 1, 0,
+			N_CUSTOMERS_TEST, 1);
+	fclose(f);
+}
+
+/** A full route and one with the rest of the customers */
+static void
+write_solution(void)
+{
+	FILE *f = fopen(solution_path, "w");
+	fail_unless(f != NULL);
+	for (int i = 1; i <= N_CUSTOMERS_TEST; i++)
+		fprintf(f, i == ROUTE_DURATION_TEST ? "%d\n" : "%d ", i);
+	fprintf(f, "\n");
+	fclose(f);
+}
+
+/** The cache of a large problem loads back */
+static void
+large_cache(void)
+{
+	char cache_path[] = "/tmp/large_problem_cache.XXXXXX";
+	make_temp(cache_path);
+	neighbours_init(options.n_near, false);
+	problem_cache_save(cache_path, 1, false);
+	problem_destroy();
+	fail_unless(problem_cache_load(cache_path, 1, options.n_near, false));
+	fail_unless(p.n_customers == N_CUSTOMERS_TEST);
+	unlink(cache_path);
+}
+
+/**
+ * The solver keeps the two routes, one of them longer than the former
+ * limit on the number of customers, after it fails to merge them.
+ */
+static void
+large_solve(void)
+{
+	struct solution *s = eama_solver_solve();
+	fail_unless(s->n_routes == 2);
+	fail_unless(solution_feasible(s));
+	solution_check_missed_customers(s);
+	int max_size = 0;
+	for (int i = 0; i < s->n_routes; i++)
+		max_size = MAX(max_size, s->routes[i]->size - 2);
+	fail_unless(max_size > 2000);
+	solution_delete(s);
+}
+
+int
+main(void)
+{
+	make_temp(problem_path);
+	make_temp(solution_path);
+	const char *argv[] = {
+		"large_problem.test", problem_path, "/dev/null",
+		"--initial_solution", solution_path, "--log_level", "none",
+		"--t_max_ms", "1000", "--seed", "1",
+	};
+	parse_arguments(lengthof(argv), argv);
+
+	memory_init();
+	pools_init();
+	fiber_init(fiber_c_invoke);
+	random_init();
+	pseudo_random_seed(options.seed);
+
+	write_problem();
+	write_solution();
+	problem_decode(problem_path);
+	large_cache();
+	large_solve();
+	problem_destroy();
+	unlink(solution_path);
+	unlink(problem_path);
+
+	pools_free();
+	memory_free();
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include "unit.h"
 
+#include "core/memory.h"
 #include "core/random.h"
 
 #include "problem.h"
@@ -239,9 +240,97 @@ applicable(void)
 	return 0;
 }
 
+/** The lower bound never exceeds the delta */
+static void
+delta_lower_bounds(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		/* The last customer stays ejected */
+		int v_route_len = randint(0, (n - 1) / 2);
+		struct route *v_route = route_new();
+		struct route *w_route = route_new();
+		route_init(v_route, &cs[0], v_route_len);
+		route_init(w_route, &cs[v_route_len], n - 1 - v_route_len);
+		struct route *routes[2] = {v_route, w_route};
+		for (int i = 0; i < 100; i++) {
+			struct route *r = routes[randint(0, 1)];
+			struct customer *v =
+				r->customers[randint(0, r->size - 1)];
+			r = routes[randint(0, 1)];
+			struct customer *w =
+				r->customers[randint(0, r->size - 1)];
+			enum modification_type type = randint(TWO_OPT, INSERT);
+			if (type == INSERT)
+				w = cs[n - 1];
+			struct modification m = modification_new(type, v, w);
+			if (v == w || !modification_applicable(m))
+				continue;
+			double alpha = real_random_in_range(0, 2);
+			double beta = real_random_in_range(0, 2);
+			double bound = modification_delta_lower_bound(m, alpha,
+								      beta);
+			if (bound > modification_delta(m, alpha, beta) + EPS7)
+				exit(1);
+		}
+	}
+}
+
+/** Ejecting customers at once leaves the route as one by one does */
+static void
+bulk_ejections(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		struct route *bulk = route_new();
+		route_init(bulk, &cs[0], n);
+		struct route *single = route_dup(bulk);
+		struct customer *ejected[MAX_N_CUSTOMERS_TEST];
+		int n_ejected = 0;
+		for (int i = 1; i < bulk->size - 1; i++) {
+			if (randint(0, 2) != 0)
+				continue;
+			ejected[n_ejected++] = bulk->customers[i];
+			struct modification m = modification_new(
+				EJECT, single->customers[i - n_ejected + 1],
+				NULL);
+			modification_apply(m);
+		}
+		modification_apply_ejections(ejected, n_ejected);
+		for (int i = 0; i < n_ejected; i++)
+			assert_eq(ejected[i]->route, NULL);
+		assert_eq(bulk->size, single->size);
+		for (int i = 0; i < bulk->size; i++) {
+			assert_eq(bulk->customers[i]->id,
+				  single->customers[i]->id);
+			assert_eq(bulk->customers[i]->route, bulk);
+			assert_eq(bulk->customers[i]->idx, i);
+			struct route_tw_data *a = &bulk->tw[i];
+			struct route_tw_data *b = &single->tw[i];
+			if (a->a != b->a || a->z != b->z ||
+			    fabs(a->tw_pf - b->tw_pf) > EPS5 ||
+			    fabs(a->tw_sf - b->tw_sf) > EPS5 ||
+			    fabs(bulk->demand_pf[i] - single->demand_pf[i]) > EPS5 ||
+			    fabs(bulk->demand_sf[i] - single->demand_sf[i]) > EPS5)
+				exit(1);
+		}
+		route_delete(single);
+	}
+}
+
 int
 main(void)
 {
+	memory_init();
+	pools_init();
 	random_init();
 	random_insertions(100);
 	random_ejections(100);
@@ -251,5 +340,9 @@ main(void)
 	random_inter_route_exchanges(100);
 
 	applicable();
+	delta_lower_bounds(100);
+	bulk_ejections(100);
+	pools_free();
+	memory_free();
 	return 0;
 }
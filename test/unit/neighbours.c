@@ -0,0 +1,148 @@
+#include "unit.h"
+
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "generators.h"
+#include "neighbours.h"
+#include "parallel.h"
+
+#define MAX_N_CUSTOMERS_TEST 300
+
+#define randint (int)pseudo_random_in_range
+
+static struct customer *cs[MAX_N_CUSTOMERS_TEST + 1];
+
+/** Order of the rows: by the distance from cs[origin], then by id */
+static int origin;
+
+static int
+by_distance_cmp(const void *lhs, const void *rhs)
+{
+	int a = *(const int *)lhs, b = *(const int *)rhs;
+	double da = problem_customer_distance(cs[origin], cs[a]);
+	double db = problem_customer_distance(cs[origin], cs[b]);
+	if (da != db)
+		return da < db ? -1 : 1;
+	return a < b ? -1 : a > b;
+}
+
+/**
+ * Compare the grid rows with the prefixes of the fully sorted rows,
+ * on uniform, collinear and coincident customers.
+ */
+static void
+nearest_rows(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		int n = p.n_customers;
+		cs[0] = p.depot;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[c->id] = c;
+		int layout = randint(0, 3);
+		for (int i = 1; i <= n; i++) {
+			if (layout == 1)
+				cs[i]->y = 7.;
+			else if (layout == 2)
+				cs[i]->x = cs[i]->y = 7.;
+			else if (layout == 3)
+				cs[i]->x = randint(0, 10);
+		}
+		int k = randint(1, n + 5);
+		neighbours_init(k, false);
+		k = MIN(k, n);
+		fail_unless(neighbours_k() == k);
+
+		int row[MAX_N_CUSTOMERS_TEST];
+		for (origin = 0; origin <= n; origin++) {
+			for (int i = 0; i < n; i++)
+				row[i] = i + 1;
+			qsort(row, n, sizeof(row[0]), by_distance_cmp);
+			const int *near = neighbours_row(origin);
+			for (int i = 0; i < k; i++)
+				fail_unless(near[i] == row[i]);
+		}
+		neighbours_free();
+	}
+}
+
+/** Every row lists its customers in the order of (neighbours_key, id) */
+static void
+check_row_keys(int k)
+{
+	cs[0] = p.depot;
+	struct customer *c;
+	rlist_foreach_entry(c, &p.customers, in_route)
+		cs[c->id] = c;
+	for (int i = 0; i <= p.n_customers; i++) {
+		const int *row = neighbours_row(i);
+		for (int j = 1; j < k; j++) {
+			double prev = neighbours_key(cs[i], cs[row[j - 1]]);
+			double next = neighbours_key(cs[i], cs[row[j]]);
+			fail_unless(prev < next ||
+				    (prev == next && row[j - 1] < row[j]));
+		}
+	}
+}
+
+/**
+ * The distance matrix, the infeasible arcs and the neighbour lists
+ * built on several threads, with or without parallel_start(), are
+ * bit-identical to the serial ones.
+ */
+static void
+parallel_rows(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		bool tw = randint(0, 1);
+		int k = randint(1, p.n_customers);
+		int n = p.n_customers + 1;
+		size_t matrix_size = sizeof(distance_t) * n *
+				     p.distance_matrix_stride;
+		size_t arcs_size = sizeof(uint64_t) * n *
+				   p.infeasible_arcs_stride;
+		size_t rows_size = sizeof(int) * n * k;
+		void *matrix = xmalloc(matrix_size);
+		void *arcs = xmalloc(arcs_size);
+		void *rows = xmalloc(rows_size);
+		neighbours_init(k, tw);
+		memcpy(matrix, p.distance_matrix, matrix_size);
+		memcpy(arcs, p.infeasible_arcs, arcs_size);
+		memcpy(rows, neighbours_row(0), rows_size);
+
+		parallel_set_n_threads(randint(2, 8));
+		bool pool = randint(0, 1);
+		if (pool)
+			parallel_start();
+		problem_init_distance_matrix();
+		neighbours_init(k, tw);
+		fail_unless(memcmp(matrix, p.distance_matrix, matrix_size) == 0);
+		fail_unless(memcmp(arcs, p.infeasible_arcs, arcs_size) == 0);
+		fail_unless(memcmp(rows, neighbours_row(0), rows_size) == 0);
+		check_row_keys(k);
+		if (pool)
+			parallel_stop();
+		parallel_set_n_threads(1);
+
+		free(matrix);
+		free(arcs);
+		free(rows);
+		neighbours_free();
+	}
+}
+
+int
+main(void)
+{
+	memory_init();
+	pools_init();
+	random_init();
+	nearest_rows(300);
+	parallel_rows(100);
+	pools_free();
+	memory_free();
+	return 0;
+}
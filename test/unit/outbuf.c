@@ -0,0 +1,122 @@
+#include "unit.h"
+
+#include <limits.h>
+#include <math.h>
+
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "outbuf.h"
+#include "utils.h"
+
+#define randint (int)pseudo_random_in_range
+
+/** A double of a random magnitude, often a decimal tie or an integer */
+static double
+random_double(void)
+{
+	double v;
+	switch (randint(0, 3)) {
+	case 0:
+		v = ldexp((double)(real_random() >> 11), randint(-80, 30));
+		break;
+	case 1:
+		v = (double)randint(0, 2000000) / 2. /
+		    pow(10., randint(0, 8));
+		break;
+	case 2:
+		v = randint(0, 10000000);
+		break;
+	default:
+		v = real_random_in_range(0, 1000000) / 997.;
+		break;
+	}
+	return randint(0, 3) == 0 ? -v : v;
+}
+
+static bool
+outbuf_equals(struct outbuf *b, const char *expected)
+{
+	bool equal = b->size == strlen(expected) &&
+		     memcmp(b->data, expected, b->size) == 0;
+	outbuf_reset(b);
+	return equal;
+}
+
+/** The numbers are formatted exactly like snprintf() does */
+static void
+format_numbers(int n_tests)
+{
+	struct outbuf b;
+	outbuf_create(&b);
+	char expected[512];
+	const double special[] = {
+		0., -0., 1e-5, 9.999995e-5, 1e-4, 999999.5, 9999995.,
+		1e7, 0.5, 1.5, 2.5, 0.125, INFINITY, -INFINITY, NAN, 1e300,
+		5e-324,
+	};
+	for (int t = 0; t < n_tests; t++) {
+		double v = t < (int)lengthof(special) ?
+			   special[t] : random_double();
+		snprintf(expected, sizeof(expected), "%g", v);
+		outbuf_double(&b, v);
+		fail_unless(outbuf_equals(&b, expected));
+
+		int decimals = randint(0, 20);
+		snprintf(expected, sizeof(expected), "%.*f", decimals, v);
+		outbuf_fixed(&b, v, decimals);
+		fail_unless(outbuf_equals(&b, expected));
+
+		long long i = (long long)real_random();
+		snprintf(expected, sizeof(expected), "%lld", i);
+		outbuf_int(&b, i);
+		fail_unless(outbuf_equals(&b, expected));
+	}
+	outbuf_int(&b, LLONG_MIN);
+	snprintf(expected, sizeof(expected), "%lld", LLONG_MIN);
+	fail_unless(outbuf_equals(&b, expected));
+	outbuf_destroy(&b);
+}
+
+/** The buffer grows over many appends and is written in full */
+static void
+write_file(void)
+{
+	char path[] = "/tmp/outbuf_test.XXXXXX";
+	int fd = mkstemp(path);
+	fail_unless(fd >= 0);
+	close(fd);
+	struct outbuf b;
+	outbuf_create(&b);
+	size_t size = 0;
+	for (int i = 0; i < 100000; i++) {
+		outbuf_int(&b, i);
+		outbuf_char(&b, '\n');
+		size = b.size;
+	}
+	char *expected = xmalloc(size);
+	memcpy(expected, b.data, size);
+	outbuf_write_file(&b, path);
+	fail_unless(b.size == 0);
+	FILE *f = fopen(path, "rb");
+	fail_unless(f != NULL);
+	char *actual = xmalloc(size + 1);
+	fail_unless(fread(actual, 1, size + 1, f) == size);
+	fclose(f);
+	fail_unless(memcmp(actual, expected, size) == 0);
+	free(actual);
+	free(expected);
+	outbuf_destroy(&b);
+	unlink(path);
+}
+
+int
+main(void)
+{
+	memory_init();
+	random_init();
+	format_numbers(200000);
+	write_file();
+	memory_free();
+	return 0;
+}
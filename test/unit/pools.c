@@ -0,0 +1,159 @@
+#include "unit.h"
+
+#include "core/fiber.h"
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "cli.h"
+#include "eama_solver.h"
+#include "pools.h"
+#include "problem_decode.h"
+
+#define N_CUSTOMERS_TEST 100
+
+#define randint (int)pseudo_random_in_range
+
+static char problem_path[] = "/tmp/pools_test.XXXXXX";
+
+/** Live objects of the pools */
+struct pools_counts {
+	size_t customer;
+	size_t route;
+	size_t route_data;
+	size_t rlist_assign_op;
+};
+
+static struct pools_counts
+pools_counts(void)
+{
+	struct pools_counts c = {
+		.customer = mempool_count(&pools.customer),
+		.route = mempool_count(&pools.route),
+		.route_data = 0,
+		.rlist_assign_op = mempool_count(&pools.rlist_assign_op),
+	};
+	for (int i = 0; i < ROUTE_DATA_POOL_COUNT; i++)
+		c.route_data += mempool_count(&pools.route_data[i]);
+	return c;
+}
+
+static bool
+pools_counts_equal(struct pools_counts a, struct pools_counts b)
+{
+	return a.customer == b.customer && a.route == b.route &&
+	       a.route_data == b.route_data &&
+	       a.rlist_assign_op == b.rlist_assign_op;
+}
+
+/** Random customers with wide time windows, ten of them fill a vehicle */
+static void
+write_problem(void)
+{
+	FILE *f = fopen(problem_path, "w");
+	fail_unless(f != NULL);
+	fprintf(f, "pools\n\nVEHICLE\nNUMBER     CAPACITY\n"
+		"  %d          100\n\nCUSTOMER\nCUST NO.  XCOORD.    YCOORD."
+		"    DEMAND   READY TIME  DUE DATE   SERVICE TIME\n\n",
+		N_CUSTOMERS_TEST);
+	fprintf(f, "%5d %5d %5d %5d %5d %5d %5d\n", 0, 50, 50, 0, 0, 1000, 0);
+	for (int i = 1; i <= N_CUSTOMERS_TEST; i++) {
+		int e = randint(0, 500);
+		fprintf(f, "%5d %5d %5d %5d %5d %5d %5d\n", i,
+			randint(0, 100), randint(0, 100), 10, e,
+			e + randint(100, 300), 10);
+	}
+	fclose(f);
+}
+
+/**
+ * A rollback, nested or not, frees everything allocated since its
+ * savepoint, a release keeps only the routes left in the solution.
+ */
+static void
+savepoint_counts(int n_tests, struct pools_counts problem)
+{
+	struct solution *s = solution_default();
+	for (int t = 0; t < n_tests; t++) {
+		struct pools_counts before = pools_counts();
+		solution_savepoint(s);
+		int depth = randint(1, 3);
+		for (int i = 1; i < depth; i++) {
+			solution_eliminate_random_route(s);
+			solution_savepoint(s);
+		}
+		solution_eliminate_random_route(s);
+		fail_unless(mempool_count(&pools.rlist_assign_op) > 0);
+		if (randint(0, 1)) {
+			for (int i = 0; i < depth; i++)
+				solution_rollback_to_savepoint(s);
+			fail_unless(pools_counts_equal(pools_counts(), before));
+		} else {
+			for (int i = 0; i < depth; i++)
+				solution_release_savepoint(s);
+			fail_unless(mempool_count(&pools.rlist_assign_op) == 0);
+			fail_unless(mempool_count(&pools.route) ==
+				    (size_t)s->n_routes);
+		}
+	}
+	solution_delete(s);
+	fail_unless(pools_counts_equal(pools_counts(), problem));
+}
+
+/** The ejected customers and w are freed with the solution */
+static void
+ejected_counts(struct pools_counts problem)
+{
+	struct solution *s = solution_default();
+	solution_eliminate_random_route(s);
+	solution_eliminate_random_route(s);
+	s->w = solution_ejection_pool_pop(s);
+	fail_unless(!rlist_empty(&s->ejection_pool));
+	solution_delete(s);
+	fail_unless(pools_counts_equal(pools_counts(), problem));
+}
+
+/** Nothing the solver allocates outlives the solution it returns */
+static void
+solve_counts(struct pools_counts problem)
+{
+	struct solution *s = eama_solver_solve();
+	fail_unless(s->n_routes < N_CUSTOMERS_TEST);
+	solution_delete(s);
+	fail_unless(pools_counts_equal(pools_counts(), problem));
+}
+
+int
+main(void)
+{
+	int fd = mkstemp(problem_path);
+	fail_unless(fd >= 0);
+	close(fd);
+	const char *argv[] = {
+		"pools.test", problem_path, "/dev/null", "--log_level", "none",
+		"--t_max_ms", "300", "--seed", "1",
+	};
+	parse_arguments(lengthof(argv), argv);
+
+	memory_init();
+	pools_init();
+	fiber_init(fiber_c_invoke);
+	random_init();
+	pseudo_random_seed(options.seed);
+
+	write_problem();
+	problem_decode(problem_path);
+	struct pools_counts problem = pools_counts();
+	fail_unless(problem.customer == N_CUSTOMERS_TEST + 1);
+	fail_unless(problem.route == 0 && problem.route_data == 0 &&
+		    problem.rlist_assign_op == 0);
+	savepoint_counts(20, problem);
+	ejected_counts(problem);
+	solve_counts(problem);
+	problem_destroy();
+	fail_unless(mempool_count(&pools.customer) == 0);
+	unlink(problem_path);
+
+	pools_free();
+	memory_free();
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include "unit.h"
+
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "generators.h"
+#include "neighbours.h"
+#include "problem_cache.h"
+
+#define MAX_N_CUSTOMERS_TEST 300
+
+#define randint (int)pseudo_random_in_range
+
+static bool
+customers_equal(struct customer *a, struct customer *b)
+{
+	return a->id == b->id && a->x == b->x && a->y == b->y &&
+	       a->demand == b->demand && a->e == b->e && a->l == b->l &&
+	       a->s == b->s;
+}
+
+/**
+ * A saved problem loads back bit for bit and a cache built for other
+ * sources or neighbour lists is rejected.
+ */
+static void
+save_load(int n_tests)
+{
+	char path[] = "/tmp/problem_cache_test.XXXXXX";
+	int fd = mkstemp(path);
+	fail_unless(fd >= 0);
+	close(fd);
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(MAX_N_CUSTOMERS_TEST);
+		bool tw = randint(0, 1);
+		int k = randint(1, p.n_customers);
+		uint64_t hash = real_random();
+		neighbours_init(k, tw);
+		problem_cache_save(path, hash, tw);
+
+		int n = p.n_customers + 1;
+		size_t matrix_size = sizeof(distance_t) * n *
+				     p.distance_matrix_stride;
+		size_t arcs_size = sizeof(uint64_t) * n *
+				   p.infeasible_arcs_stride;
+		size_t rows_size = sizeof(int) * n * k;
+		void *matrix = xmalloc(matrix_size);
+		void *arcs = xmalloc(arcs_size);
+		void *rows = xmalloc(rows_size);
+		memcpy(matrix, p.distance_matrix, matrix_size);
+		memcpy(arcs, p.infeasible_arcs, arcs_size);
+		memcpy(rows, neighbours_row(0), rows_size);
+		struct problem saved = p;
+		struct customer *cs[MAX_N_CUSTOMERS_TEST];
+		struct customer *c;
+		int i = 0;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[i++] = c;
+
+		fail_if(problem_cache_load(path, hash + 1, k, tw));
+		fail_if(problem_cache_load(path, hash, k, !tw));
+		if (k < p.n_customers)
+			fail_if(problem_cache_load(path, hash, k + 1, tw));
+		fail_unless(p.distance_matrix == saved.distance_matrix);
+
+		fail_unless(problem_cache_load(path, hash, randint(1, k), tw));
+		fail_unless(p.cache_map != NULL);
+		fail_unless(p.n_customers == saved.n_customers);
+		fail_unless(p.vc == saved.vc);
+		fail_unless(customers_equal(p.depot, saved.depot));
+		i = 0;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			fail_unless(customers_equal(cs[i++], c));
+		fail_unless(memcmp(matrix, p.distance_matrix, matrix_size) == 0);
+		fail_unless(memcmp(arcs, p.infeasible_arcs, arcs_size) == 0);
+		fail_unless(neighbours_ready(k, tw));
+		fail_unless(memcmp(rows, neighbours_row(0), rows_size) == 0);
+		problem_free_tables();
+
+		free(matrix);
+		free(arcs);
+		free(rows);
+	}
+	unlink(path);
+}
+
+int
+main(void)
+{
+	memory_init();
+	pools_init();
+	random_init();
+	save_load(100);
+	pools_free();
+	memory_free();
+	return 0;
+}
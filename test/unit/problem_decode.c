@@ -0,0 +1,304 @@
+#include "unit.h"
+
+#include <sys/wait.h>
+
+#include "core/memory.h"
+#include "core/random.h"
+
+#include "dist.h"
+#include "generators.h"
+#include "problem_decode.h"
+
+#define MAX_N_CUSTOMERS_TEST 100
+
+#define randint (int)pseudo_random_in_range
+
+static char path[] = "/tmp/problem_decode_test.XXXXXX";
+
+static const char *header =
+	"c1_2_1\r\n\r\nVEHICLE\r\nNUMBER     CAPACITY\r\n  50          200\r\n"
+	"\r\nCUSTOMER\r\nCUST NO.  XCOORD.    YCOORD.    DEMAND   "
+	"READY TIME  DUE DATE   SERVICE TIME\r\n \r\n";
+
+static void
+write_file(const char *contents)
+{
+	FILE *f = fopen(path, "w");
+	fail_unless(f != NULL);
+	fputs(contents, f);
+	fclose(f);
+}
+
+/** A random number in one of the formats the parser treats specially */
+static double
+random_number(char *buf, size_t size)
+{
+	static const char *formats[] = {
+		"+%.2f", "%.0f", "%.1f", "%.3f", "%.17g", "%g", "%e",
+	};
+	int format = randint(0, lengthof(formats) - 1);
+	double v = real_random_in_range(0, 1000000) / 997.;
+	if (format > 0 && randint(0, 3) == 0)
+		v = -v;
+	snprintf(buf, size, formats[format], v);
+	return strtod(buf, NULL);
+}
+
+/** The customers are decoded exactly like strtod() would */
+static void
+decode_numbers(int n_tests)
+{
+	static char contents[1 << 16];
+	double expected[MAX_N_CUSTOMERS_TEST + 1][6];
+	for (int t = 0; t < n_tests; t++) {
+		int n = randint(1, MAX_N_CUSTOMERS_TEST);
+		int len = snprintf(contents, sizeof(contents), "%s", header);
+		for (int i = 0; i <= n; i++) {
+			len += snprintf(contents + len, sizeof(contents) - len,
+					"%5d", i);
+			for (int j = 0; j < 6; j++) {
+				char buf[64];
+				expected[i][j] = random_number(buf, sizeof(buf));
+				len += snprintf(contents + len,
+						sizeof(contents) - len,
+						randint(0, 1) ? " %s" : "\t%s",
+						buf);
+			}
+			len += snprintf(contents + len, sizeof(contents) - len,
+					randint(0, 1) ? "\r\n" : "\n");
+		}
+		write_file(contents);
+		problem_decode(path);
+		fail_unless(p.n_customers == n);
+		fail_unless(p.vc == 200.);
+		struct customer *c = p.depot;
+		for (int i = 0; i <= n; i++) {
+			fail_unless(c->id == i);
+			fail_unless(c->x == expected[i][0]);
+			fail_unless(c->y == expected[i][1]);
+			fail_unless(c->demand == expected[i][2]);
+			fail_unless(c->e == expected[i][3]);
+			fail_unless(c->l == expected[i][4]);
+			fail_unless(c->s == expected[i][5]);
+			c = i == 0 ?
+			    rlist_first_entry(&p.customers, struct customer,
+					      in_route) :
+			    rlist_next_entry(c, in_route);
+		}
+	}
+}
+
+static const char *vrplib_weight_formats[] = {
+	"FULL_MATRIX", "LOWER_ROW", "UPPER_ROW", "LOWER_DIAG_ROW",
+	"UPPER_DIAG_ROW",
+};
+
+/**
+ * A VRPLIB problem with the depot at a random node. Returns the node
+ * index of every id: the depot swaps places with the first node. The
+ * service times are either in the SERVICE_TIME_SECTION or given by
+ * SERVICE_TIME for all the nodes but the depot.
+ */
+static int
+vrplib_write(char *contents, size_t size, int n, bool explicit_distances,
+	     int format, double nodes[][7],
+	     double weights[][MAX_N_CUSTOMERS_TEST + 1], int *order)
+{
+	int depot = randint(0, n);
+	int len = snprintf(contents, size,
+			   "NAME : test\nCOMMENT : (no of trucks: 5)\n"
+			   "TYPE : VRPTW\nDIMENSION: %d\nCAPACITY :200\r\n"
+			   "EDGE_WEIGHT_TYPE : %s\n", n + 1,
+			   explicit_distances ? "EXPLICIT" : "EUC_2D");
+	if (explicit_distances)
+		len += snprintf(contents + len, size - len,
+				"EDGE_WEIGHT_FORMAT : %s\n",
+				vrplib_weight_formats[format]);
+	for (int i = 0; i <= n; i++)
+		for (int j = 0; j < 7; j++)
+			nodes[i][j] = randint(0, 1000);
+	bool service_time_section = randint(0, 1);
+	if (!service_time_section) {
+		int service_time = randint(1, 1000);
+		len += snprintf(contents + len, size - len,
+				"SERVICE_TIME : %d\n", service_time);
+		for (int i = 0; i <= n; i++)
+			nodes[i][5] = i == depot ? 0 : service_time;
+	}
+	const char *sections[] = {
+		"NODE_COORD_SECTION", "DEMAND_SECTION",
+		"TIME_WINDOW_SECTION", "SERVICE_TIME_SECTION",
+	};
+	const int columns[][2] = { {0, 2}, {2, 3}, {3, 5}, {5, 6} };
+	int n_sections = lengthof(sections) - !service_time_section;
+	for (int s = 0; s < n_sections; s++) {
+		len += snprintf(contents + len, size - len, "%s\n",
+				sections[s]);
+		for (int i = 0; i <= n; i++) {
+			len += snprintf(contents + len, size - len, "%d", i + 1);
+			for (int j = columns[s][0]; j < columns[s][1]; j++)
+				len += snprintf(contents + len, size - len,
+						" %.0f", nodes[i][j]);
+			len += snprintf(contents + len, size - len, "\n");
+		}
+	}
+	if (explicit_distances) {
+		len += snprintf(contents + len, size - len,
+				"EDGE_WEIGHT_SECTION\n");
+		for (int i = 0; i <= n; i++) {
+			for (int j = 0; j <= n; j++) {
+				bool lower = j < i || (format >= 3 && j == i);
+				bool upper = j > i || (format >= 3 && j == i);
+				weights[i][j] = i == j && format < 3 ? 0 :
+						format == 0 || j > i ?
+						randint(0, 1000) : weights[j][i];
+				if (format == 0 || (format % 2 == 1 && lower) ||
+				    (format % 2 == 0 && upper))
+					len += snprintf(contents + len,
+							size - len, " %.0f",
+							weights[i][j]);
+			}
+			len += snprintf(contents + len, size - len, "\n");
+		}
+	}
+	len += snprintf(contents + len, size - len,
+			"DISPLAY_DATA_SECTION\n1 1 1\nDEPOT_SECTION\n %d\n -1\n"
+			"EOF\n", depot + 1);
+	fail_unless(len < (int)size);
+	for (int i = 0; i <= n; i++)
+		order[i] = i;
+	order[0] = depot;
+	order[depot] = 0;
+	return depot;
+}
+
+/**
+ * The VRPLIB problems load the same customers as the Solomon ones,
+ * the explicit distances are taken exactly.
+ */
+static void
+decode_vrplib(int n_tests)
+{
+	static char contents[1 << 20];
+	static double nodes[MAX_N_CUSTOMERS_TEST + 1][7];
+	static double weights[MAX_N_CUSTOMERS_TEST + 1]
+			     [MAX_N_CUSTOMERS_TEST + 1];
+	int order[MAX_N_CUSTOMERS_TEST + 1];
+	for (int t = 0; t < n_tests; t++) {
+		int n = randint(1, MAX_N_CUSTOMERS_TEST);
+		bool explicit_distances = randint(0, 1);
+		int format = randint(0, lengthof(vrplib_weight_formats) - 1);
+		vrplib_write(contents, sizeof(contents), n, explicit_distances,
+			     format, nodes, weights, order);
+		write_file(contents);
+		problem_decode(path);
+		fail_unless(p.n_customers == n);
+		fail_unless(p.vc == 200.);
+		fail_unless(p.explicit_distances == explicit_distances);
+		struct customer *cs[MAX_N_CUSTOMERS_TEST + 1];
+		cs[0] = p.depot;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[c->id] = c;
+		for (int i = 0; i <= n; i++) {
+			double *node = nodes[order[i]];
+			fail_unless(cs[i]->id == i);
+			fail_unless(cs[i]->x == node[0]);
+			fail_unless(cs[i]->y == node[1]);
+			fail_unless(cs[i]->demand == node[2]);
+			fail_unless(cs[i]->e == node[3]);
+			fail_unless(cs[i]->l == node[4]);
+			fail_unless(cs[i]->s == node[5]);
+		}
+		for (int i = 0; i <= n; i++) {
+			for (int j = 0; j <= n; j++) {
+				double d = explicit_distances ?
+					   weights[order[i]][order[j]] :
+					   problem_customer_distance(cs[i],
+								     cs[j]);
+				fail_unless(dist_id(i, j) == (distance_t)d);
+				fail_unless(arc_infeasible_id(i, j) ==
+					    (cs[i]->e + cs[i]->s +
+					     dist_id(i, j) > cs[j]->l));
+			}
+			if (explicit_distances)
+				fail_unless(problem_customer_distance(
+					cs[i], cs[0]) == dist_id(i, 0));
+		}
+	}
+}
+
+/**
+ * Decode the file in a child process and check that it panics with
+ * the given line number.
+ */
+static void
+decode_fails_at(const char *contents, int line)
+{
+	write_file(contents);
+	int fds[2];
+	fail_unless(pipe(fds) == 0);
+	pid_t pid = fork();
+	fail_unless(pid >= 0);
+	if (pid == 0) {
+		dup2(fds[1], STDERR_FILENO);
+		problem_decode(path);
+		_exit(0);
+	}
+	close(fds[1]);
+	char out[1024];
+	ssize_t size = read(fds[0], out, sizeof(out) - 1);
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	fail_unless(WIFEXITED(status) && WEXITSTATUS(status) != 0);
+	fail_unless(size > 0);
+	out[size] = '\0';
+	char expected[64];
+	snprintf(expected, sizeof(expected), ":%d:", line);
+	fail_unless(strstr(out, expected) != NULL);
+}
+
+static void
+decode_errors(void)
+{
+	char contents[4096];
+	decode_fails_at("c1_2_1\n\nVEHICLE\nNUMBER CAPACITY\n 50 2x0\n", 5);
+	decode_fails_at("c1_2_1\n\nVEHICLE\nNUMBER\n 50 200\n", 5);
+	decode_fails_at("c1_2_1\n\nVEHICLE\nNUMBER CAPACITY\n 50 200\n", 5);
+	snprintf(contents, sizeof(contents), "%s%s", header,
+		 "0 1 2 3 4 5 6\n1 1 2 3 4 5\n");
+	decode_fails_at(contents, 11);
+	snprintf(contents, sizeof(contents), "%s%s", header,
+		 "0 1 2 3 4 5 6\n1 1 2 3 4 5 6\n3 1 2 3 4 5 6\n");
+	decode_fails_at(contents, 12);
+	snprintf(contents, sizeof(contents), "%s%s", header,
+		 "1 1 2 3 4 5 6\n");
+	decode_fails_at(contents, 10);
+	decode_fails_at("NAME : x\nDIMENSION : 2\nNODE_COORD_SECTION\n"
+			"1 0 0\n3 1 1\n", 5);
+	decode_fails_at("NAME : x\nDIMENSION : 2\nEDGE_WEIGHT_TYPE : EUC_2D"
+			"\nEDGE_WEIGHT_SECTION\n0 1\n1 0\n", 4);
+	decode_fails_at("NAME : x\nDIMENSION : 2\nEDGE_WEIGHT_TYPE : EXPLICIT"
+			"\nEDGE_WEIGHT_FORMAT : FULL_MATRIX\nEDGE_WEIGHT_SECTION"
+			"\n0 1\n1\n", 7);
+	decode_fails_at("NAME : x\nDIMENSION : 2\nDEPOT_SECTION\n1\n2\n", 5);
+}
+
+int
+main(void)
+{
+	memory_init();
+	pools_init();
+	random_init();
+	int fd = mkstemp(path);
+	fail_unless(fd >= 0);
+	close(fd);
+	decode_numbers(100);
+	decode_vrplib(100);
+	decode_errors();
+	unlink(path);
+	pools_free();
+	memory_free();
+	return 0;
+}
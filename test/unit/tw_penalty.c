@@ -1,5 +1,6 @@
 #include "unit.h"
 
+#include "core/memory.h"
 #include "core/random.h"
 
 #define TW_PENALTY_TEST
@@ -7,6 +8,8 @@
 #undef TW_PENALTY_TEST
 #include "penalty_test.h"
 
+#include "core/fiber.h"
+
 static const struct penalty_vtab tw_penalty_vtab = {
 	/* .penalty_init = */ tw_penalty_init,
 	/* .penalty_get_penalty = */ tw_penalty_get_penalty,
@@ -22,10 +25,168 @@ static const struct penalty_vtab tw_penalty_vtab = {
 	/* .penalty_exchange_penalty_delta_lower_bound = */tw_penalty_exchange_penalty_delta_lower_bound,
 };
 
+/** tw_penalty_get_insert_penalties() must match the single insertions */
+static void
+batched_insertions(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(100);
+		struct customer *cs[100];
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		struct customer *w = cs[--n];
+		struct route *route = route_new();
+		route_init(route, cs, n);
+		double penalty[100 + 2];
+		tw_penalty_get_insert_penalties(route, w, penalty);
+		for (int i = 1; i < route->size; i++) {
+			assert_eq(penalty[i], tw_penalty_get_insert_penalty(
+				route->customers[i], w));
+		}
+	}
+}
+
+static void
+ejected_route_data(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(100);
+		struct customer *cs[100];
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		if (n == 0)
+			continue;
+		struct route *route = route_new();
+		route_init(route, cs, n);
+		int k = (int)pseudo_random_in_range(0, n - 1);
+		struct route_tw_data tw[100 + 2];
+		tw_penalty_eject_into(route, k + 1, tw);
+		memmove(&cs[k], &cs[k + 1], sizeof(cs[0]) * (n - k - 1));
+		struct route *ejected = route_new();
+		route_init(ejected, cs, n - 1);
+		for (int i = 0; i < ejected->size; i++) {
+			fail_unless(tw[i].id == ejected->tw[i].id);
+			assert_eq(tw[i].a, ejected->tw[i].a);
+			assert_eq(tw[i].z, ejected->tw[i].z);
+			/* The sums may be shifted by an offset instead */
+			assert_near(tw[i].tw_pf, ejected->tw[i].tw_pf);
+			assert_near(tw[i].tw_sf, ejected->tw[i].tw_sf);
+		}
+	}
+}
+
+static void
+intra_route_segment_deltas(int n_tests)
+{
+	struct region *gc = &fiber()->gc;
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(100);
+		struct customer *cs[100];
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		if (n < 2)
+			continue;
+		struct route *route = route_new();
+		route_init(route, cs, n);
+		size_t gc_used = region_used(gc);
+		struct tw_segment_table segments;
+		tw_segment_table_create(&segments, route, gc);
+		struct customer *v =
+			route->customers[pseudo_random_in_range(1, n + 1)];
+		struct customer *w =
+			route->customers[pseudo_random_in_range(1, n)];
+		enum modification_type type = v->idx == n + 1 ||
+			pseudo_random_in_range(0, 1) == 0 ?
+			OUT_RELOCATE : EXCHANGE;
+		struct modification m = modification_new(type, v, w);
+		if (v == w || !modification_applicable(m)) {
+			region_truncate(gc, gc_used);
+			continue;
+		}
+		double delta, slow_delta;
+		if (type == OUT_RELOCATE) {
+			delta = tw_penalty_intra_route_out_relocate_delta(
+				&segments, v, w);
+			slow_delta = tw_penalty_out_relocate_penalty_delta(v, w);
+		} else {
+			delta = tw_penalty_intra_route_exchange_delta(
+				&segments, v, w);
+			slow_delta = tw_penalty_exchange_penalty_delta(v, w);
+		}
+		region_truncate(gc, gc_used);
+		double before = tw_penalty_get_penalty(route);
+		modification_apply(m);
+		double after = tw_penalty_get_penalty(route);
+		assert_near(after - before, delta);
+		assert_near(after - before, slow_delta);
+	}
+}
+
+/**
+ * Apply random chains of modifications and check the incrementally
+ * updated penalty data against a recomputation from scratch.
+ */
+static void
+incremental_updates(int n_tests)
+{
+	for (int t = 0; t < n_tests; t++) {
+		generate_random_problem(100);
+		struct customer *cs[100];
+		int n = 0;
+		struct customer *c;
+		rlist_foreach_entry(c, &p.customers, in_route)
+			cs[n++] = c;
+		if (n < 2)
+			continue;
+		struct route *routes[2];
+		routes[0] = route_new();
+		route_init(routes[0], cs, n / 2);
+		routes[1] = route_new();
+		route_init(routes[1], &cs[n / 2], n - n / 2);
+		for (int i = 0; i < 50; i++) {
+			struct route *v_route =
+				routes[pseudo_random_in_range(0, 1)];
+			struct route *w_route =
+				routes[pseudo_random_in_range(0, 1)];
+			struct customer *v = v_route->customers[
+				pseudo_random_in_range(0, v_route->size - 1)];
+			struct customer *w = w_route->customers[
+				pseudo_random_in_range(0, w_route->size - 1)];
+			struct modification m = modification_new(
+				pseudo_random_in_range(TWO_OPT, EXCHANGE),
+				v, w);
+			if (v == w || !modification_applicable(m))
+				continue;
+			modification_apply(m);
+			for (int j = 0; j < 2; j++) {
+				struct route *r = routes[j];
+				struct route_tw_data tw[100 + 2];
+				memcpy(tw, r->tw, sizeof(tw[0]) * r->size);
+				tw_penalty_init(r);
+				for (int k = 0; k < r->size; k++) {
+					assert_eq(tw[k].a, r->tw[k].a);
+					assert_eq(tw[k].z, r->tw[k].z);
+					assert_near(tw[k].tw_pf, r->tw[k].tw_pf);
+					assert_near(tw[k].tw_sf, r->tw[k].tw_sf);
+				}
+			}
+		}
+	}
+}
+
 int
 main(void)
 {
 	vtab = tw_penalty_vtab;
+	memory_init();
+	fiber_init(fiber_c_invoke);
+	pools_init();
 	random_init();
 	random_insertions(100);
 	random_ejections(100);
@@ -34,5 +195,11 @@ main(void)
 	random_out_relocations(100);
 	random_inter_route_exchanges(100);
 	random_intra_route_exchanges(100);
+	batched_insertions(100);
+	ejected_route_data(100);
+	intra_route_segment_deltas(1000);
+	incremental_updates(100);
+	pools_free();
+	memory_free();
 	return 0;
 }